@@ -9,6 +9,13 @@ Provides common data functionality
 
 #include "Data.h"
 #include <fstream>	// to write simple files without _FILE_WRITE
+#ifdef _ISCHIP
+#include <thread>
+#include <atomic>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>	// madvise()
+#endif
 
 #ifdef _FEATURES
 /************************ class Features ************************/
@@ -225,12 +232,14 @@ void ChromSizes::Read(const string& fName)
 //	@fName: full file name
 void ChromSizes::Write(const string& fName) const
 {
+	const string tmpName = FS::TmpFileName(fName);	// concurrent runs may share service dir
 	ofstream file;
 
-	file.open (fName.c_str(), ios_base::out);
+	file.open (tmpName.c_str(), ios_base::out);
 	for(cIter it=cBegin(); it!=cEnd(); it++)
 		file << Chrom::AbbrName(CID(it)) << TAB << Length(it) << LF;
 	file.close();
+	FS::CommitFile(tmpName, fName);
 }
 
 // Fills external vector by chrom IDs relevant to file's names found in given directory.
@@ -244,20 +253,25 @@ chrid ChromSizes::GetChromIDs(vector<chrid>& cIDs, const string& gName)
 
 	chrid	cid;				// chrom ID relevant to current file in files
 	int		prefixLen;			// length of prefix of chrom file name
-	chrid	extLen = BYTE(_ext.length());
-	chrid	cnt = chrid(files.size());
+	BYTE	extLen = BYTE(_ext.length());
+	size_t	cnt = files.size();		// may exceed chrid capacity on scaffold-level assemblies
+	size_t	skipCnt = 0;			// count of skipped files with unsupported chrom names
 	
 	cIDs.reserve(cnt);
 	sort(files.begin(), files.end());
 	// remove additional names and sort listFiles
-	for(chrid i=0; i<cnt; i++) {
+	for(size_t i=0; i<cnt; i++) {
 		if( (prefixLen = CommonPrefixLength(files[i], extLen)) < 0 )		// right chrom file name
 			continue;
 		// filter additional names
 		cid = Chrom::ValidateID(files[i].substr(prefixLen, files[i].length() - prefixLen - extLen));
 		if(cid != Chrom::UnID) 		// "pure" chrom's name
 			cIDs.push_back(cid);
+		else	skipCnt++;
 	}
+	if(skipCnt)
+		Err(to_string(skipCnt) + " files with names other than "
+			+ Chrom::Abbr + "<N|X|Y|M> are ignored", gName).Warning();
 	sort(cIDs.begin(), cIDs.end());
 	return chrid(cIDs.size());
 }
@@ -405,6 +419,69 @@ chrid ChromSizesExt::SetTreated(bool statedAll, const Features* const templ)
 	return _treatedCnt;
 }
 
+// Sets actually treated chromosomes according given chroms and custom chrom
+//	@cIDs: sorted IDs of chroms to treat
+//	return: number of treated chromosomes
+chrid ChromSizesExt::SetTreated(const vector<chrid>& cIDs)
+{
+	_treatedCnt = 0;
+
+	for(Iter it = Begin(); it!=End(); it++)
+		_treatedCnt += 
+			(it->second.Treated = Chrom::IsCustom(CID(it)) 
+			&& binary_search(cIDs.begin(), cIDs.end(), CID(it)));
+	return _treatedCnt;
+}
+
+// Concurrently builds chrom's defined regions service files that do not exist yet
+//	@thrCnt: number of threads
+//	@all: if true then build files for all chromosomes, otherwise for treated ones only
+//	@prMsg: true if print message about service files generation
+void ChromSizesExt::Prepare(thrid thrCnt, bool all, bool prMsg) const
+{
+	if(!IsServAvail() || !RefExt().length())	return;		// nothing to save or nothing to read
+
+	vector<chrid> cIDs;		// chroms without service files
+	for(cIter it=cBegin(); it!=cEnd(); it++)
+		if((all || IsTreated(it)) 
+		&& !FS::IsFileExist((ServName(CID(it)) + ChromDefRegions::Ext).c_str()))
+			cIDs.push_back(CID(it));
+	if(!cIDs.size())	return;
+
+	atomic<size_t> next(0);	// index of the next chrom to treat
+	string	errMsg;			// the first exception message
+	mutex	errLock;
+	auto stop = [&](const char* msg) {
+		lock_guard<mutex> lock(errLock);
+		if(!errMsg.length())	errMsg = msg;
+		next = cIDs.size();		// stop all threads
+	};
+	auto buildFiles = [&]() {
+		try {
+			for(size_t i; (i = next++) < cIDs.size(); ) {
+				ChromDefRegions rgns(ServName(cIDs[i]));
+				if(!rgns.Empty())	continue;		// just created by a concurrent run
+				FaFile file(RefName(cIDs[i]) + RefExt(), &rgns);
+				file.ReadSeq(NULL);		// fill def regions only
+				file.CLoseReading();	// save def regions
+			}
+		}
+		catch(const Err& e)			{ stop(e.what()); }
+		catch(const exception& e)	{ stop(e.what()); }
+	};
+	if(thrCnt > cIDs.size())	thrCnt = thrid(cIDs.size());
+	vector<thread> threads;
+	threads.reserve(thrCnt - 1);
+	for(thrid i=1; i<thrCnt; i++)
+		threads.emplace_back(buildFiles);
+	buildFiles();					// main thread works too
+	for(thread& t : threads)	t.join();
+	if(errMsg.length())		Err(errMsg).Throw();
+	if(prMsg)
+		dout << cIDs.size() << " *" << ChromDefRegions::Ext << " service files created\n",
+		fflush(stdout);
+}
+
 inline void PrintChromID(char sep, chrid cID) { dout << sep << Chrom::Mark(cID); }
 
 // Prints threated chroms short names, starting with SPACE
@@ -481,31 +558,36 @@ bool RefSeq::Init(const string& fName, ChromDefRegions& rgns, bool fill)
 
 	_len = file.ChromLength();
 	if(fill) {
-		try { _seq = new char[_len]; }
+		try { _seq = _arena ? _arena->Get(_len) : new char[_len]; }
 		catch(const bad_alloc&) { Err(Err::F_MEM, fName.c_str()).Throw(); }
-		const char* line = file.Line();		// First line is readed by FaFile()
-		chrlen linelen;
-		_len = 0;
-		
-		do	memcpy(_seq + _len, line, linelen = file.LineLength()),
-			_len += linelen;
-		while(line = file.NextGetLine());
+		_len = file.ReadSeq(_seq);		// decode directly into the sequence buffer
 	}
-	else if (getN)	while(file.NextGetLine());	// just to fill chrom def regions
+	else if (rgns.Empty())	file.ReadSeq(NULL);	// just to fill chrom def regions
 	file.CLoseReading();	// only makes sense if chrom def regions were filled
-	_len;
 	return getN;
 }
 
 #if defined _ISCHIP || defined _VALIGN
 
 // Creates and fills new instance
-RefSeq::RefSeq(chrid cID, const ChromSizes& cSizes)
+//	@cID: chrom ID
+//	@cSizes: chrom sizes
+//	@fill: if false then nucleotides are not loaded (sequence-free mode):
+//	FA file is read only if chrom's defined regions are not saved yet
+//	@arena: thread's buffer keeper to place the nucleotides, or NULL to allocate own buffer
+RefSeq::RefSeq(chrid cID, const ChromSizes& cSizes, bool fill, SeqArena* arena) : _arena(arena)
 {
 	_ID = cID;
 	ChromDefRegions rgns(cSizes.ServName(cID));	// read from file or new (empty)
+	bool defRgns;		// true if chrom def regions are stated
 
-	if( Init(cSizes.RefName(cID) + cSizes.RefExt(), rgns, true)	&& !rgns.Empty() )
+	if(fill || rgns.Empty())
+		defRgns = Init(cSizes.RefName(cID) + cSizes.RefExt(), rgns, fill);
+	else {				// both length and def regions are known without FA file
+		_len = cSizes[cID];
+		defRgns = StatGaps || LetGaps;
+	}
+	if( defRgns && !rgns.Empty() )
 		_effDefRgn.Set(rgns.FirstStart(), rgns.LastEnd());
 	else
 		_effDefRgn.Set(0, Length());
@@ -541,6 +623,44 @@ RefSeq::RefSeq(const string& fName, ChromDefRegions& rgns, short minGapLen)
 
 /************************ end of class RefSeq ************************/
 
+/************************ class SeqArena ************************/
+
+bool SeqArena::HugePages = false;
+
+// Releases buffer
+void SeqArena::Free()
+{
+#ifdef __linux__
+	free(_buff);
+#else
+	delete [] _buff;
+#endif
+	_buff = NULL;
+	_size = 0;
+}
+
+// Returns buffer of at least the given size; the previous content is not kept
+//	@size: required size in bytes
+char* SeqArena::Get(size_t size)
+{
+	if (size <= _size)	return _buff;
+	Free();
+#ifdef __linux__
+	static const size_t HugePageSize = 2 << 20;
+
+	if (HugePages)	size = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+	if (posix_memalign((void**)&_buff, HugePages ? HugePageSize : sysconf(_SC_PAGESIZE), size))
+		throw bad_alloc();
+	if (HugePages)	madvise(_buff, size, MADV_HUGEPAGE);	// just advice: failure is not an error
+#else
+	_buff = new char[size];
+#endif
+	_size = size;
+	return _buff;
+}
+
+/************************ end of class SeqArena ************************/
+
 #if defined _READDENS || defined _BIOCC
 
 /************************ DefRegions ************************/
@@ -1192,42 +1312,105 @@ void LenFreq::Print(dostream& s, eCType ctype, bool prDistr)
 #if defined _ISCHIP || defined _BSDEC
 /************************ class AccumCover ************************/
 
-// Adds fragment to accumulate the coverage
-void AccumCover::AddRegion(const Region& frag)
+// Adds delta
+//	@offset: delta's offset in block
+//	@val: delta's value
+void AccumCover::Block::Add(USHORT offset, codelta val)
 {
-	covmap::iterator it1 = find(frag.Start), it2;	// 'start', 'end' entries iterator
+	if (Dense.size()) { Dense[offset] += val; return; }
+	if (Sparse.size() < SparseLen) {
+		if (Sparse.empty())	Sparse.reserve(4);
+		Sparse.emplace_back(offset, val);
+		return;
+	}
+	// turn into the flat array
+	Dense.resize(BlockLen, 0);
+	for (const item& it : Sparse)	Dense[it.first] += it.second;
+	vector<item>().swap(Sparse);
+	Dense[offset] += val;
+}
 
-	// *** set up 'start' entry
-	if (it1 == end()) {							// 'start' entry doesn't exist
-		it2 = it1 = emplace(frag.Start, 1).first;
-		if (it1 != begin())						// 'start' point is not the first one at all
-			it1->second += (--it2)->second;		// correct val by prev point; keep it1 unchanged
+// Adds another block
+void AccumCover::Block::Add(const Block& blk)
+{
+	if (blk.Dense.size()) {
+		if (Dense.empty()) {
+			Dense = blk.Dense;
+			for (const item& it : Sparse)	Dense[it.first] += it.second;
+			vector<item>().swap(Sparse);
+		}
+		else
+			for (chrlen k = 0; k < BlockLen; k++)	Dense[k] += blk.Dense[k];
 	}
-	else {
-		it1->second++;							// incr val at existed 'start' entry
-		if (--(it2 = it1) != end()				// decr it2; previous entry exists
-			&& it2->second == it1->second)		// previous and current entries have the same value
-			erase(it1), it1 = it2;				// remove current entry as duplicated
+	else
+		for (const item& it : blk.Sparse)	Add(it.first, it.second);
+}
+
+// Move assignment
+AccumCover& AccumCover::operator=(AccumCover&& cv) noexcept
+{
+	if (this != &cv) {
+		if (IsSpilled())	remove(_spillName.c_str());
+		_blocks = move(cv._blocks);
+		_spillName = move(cv._spillName);
+		cv._spillName.clear();
+		_unsaved = cv._unsaved;
+		Closed = cv.Closed;
 	}
+	return *this;
+}
+
+// Adds another coverage of the same chrom
+//	@cv: added coverage
+void AccumCover::Add(const AccumCover& cv)
+{
+	if (cv._blocks.size() > _blocks.size())	_blocks.resize(cv._blocks.size());
+	for (size_t i = 0; i < cv._blocks.size(); i++)
+		_blocks[i].Add(cv._blocks[i]);
+}
+
+// Returns size of allocated data in bytes
+size_t AccumCover::MemSize() const
+{
+	size_t size = _blocks.capacity() * sizeof(Block);
+	for (const auto& block : _blocks)
+		size += block.Dense.capacity() * sizeof(codelta) + block.Sparse.capacity() * sizeof(item);
+	return size;
+}
 
-	// *** set up 'end' entry
-	it2 = find(frag.End);
-	fraglen val = 0;							// 'end' entry value
-	const bool newEnd = it2 == end();			// true if 'end' entry is new 
+// Saves data to temporary file as the list of nonzero deltas and releases memory
+//	@fName: temporary file name
+void AccumCover::Spill(const string& fName)
+{
+	ofstream file(fName.c_str(), ios_base::out | ios_base::binary);
+	if (!file)	Err(Err::F_OPEN, fName.c_str()).Throw();
 
-	if (newEnd) {								// 'end' entry is new
-		it2 = emplace(frag.End, 0).first;
-		val = next(it2) == end() ? 1 :			// 'end' entry is the last one at all
-			prev(it2)->second;					// grab val by prev entry
+	DoWithItem([&file](chrlen pos, codelta val) {
+		file.write((const char*)&pos, sizeof(pos));
+		file.write((const char*)&val, sizeof(val));
+	});
+	file.close();
+	if (file.fail()) {
+		remove(fName.c_str());
+		Err(Err::F_WRITE, fName.c_str()).Throw();
 	}
+	vector<Block>().swap(_blocks);
+	_spillName = fName;
+}
 
-	// *** correct range between 'start' and 'end', set 'end' entry value
-	for (it1++; /*it1 != end() &&*/ it1 != it2; it1++)		// correct values within range
-		val = ++it1->second;					// increase value
-	if ((--it1)->second == it2->second)			// is the last added entry a duplicate?
-		erase(it2);								// remove duplicated entry
-	else if (newEnd)
-		it2->second = --val;					// set new 'end' entry value
+// Restores spilled data and removes temporary file
+void AccumCover::Unspill()
+{
+	ifstream file(_spillName.c_str(), ios_base::in | ios_base::binary);
+	if (!file)	Err(Err::F_OPEN, _spillName.c_str()).Throw();
+
+	chrlen pos;
+	codelta val;
+	while (file.read((char*)&pos, sizeof(pos)) && file.read((char*)&val, sizeof(val)))
+		AddDelta(pos, val);
+	file.close();
+	remove(_spillName.c_str());
+	_spillName.clear();
 }
 
 /************************ class AccumCover: end ************************/
@@ -38,9 +38,10 @@ protected:
 	//	return: class type collection reference
 	inline T& AddElem(chrid cID, const T& val) { return _cMap[cID] = val; }
 
-	// Adds empty class type to the collection without checking cID
+	// Adds empty class type to the collection without checking cID.
+	// Moves the empty instance, so it also fits move-only types
 	//	return: class type collection reference
-	inline T& AddEmptyElem(chrid cID) { return AddElem(cID, T()); }
+	inline T& AddEmptyElem(chrid cID) { return _cMap[cID] = T(); }
 
 	inline const chrMap& Container() const { return _cMap; }
 
@@ -564,10 +565,10 @@ class ChromSizes : public Chroms<ChromSize>
 	//	@prMsg: true if print message about service fodler and chrom.sizes generation
 	void SetPath(const string& gPath, const char* sPath, bool prMsg);
 
+protected:
 	// returns true if service path is defined
 	inline bool IsServAvail() const { return _sPath.size(); }
 
-protected:
 	inline chrlen Length(cIter it) const { return Data(it).Real; }
 
 public:
@@ -652,6 +653,17 @@ public:
 	//	@templ: template bed or NULL
 	//	return: number of treated chromosomes
 	chrid	SetTreated	(bool statedAll, const Features* const templ);
+
+	// Sets actually treated chromosomes according given chroms and custom chrom
+	//	@cIDs: sorted IDs of chroms to treat
+	//	return: number of treated chromosomes
+	chrid	SetTreated	(const vector<chrid>& cIDs);
+
+	// Concurrently builds chrom's defined regions service files that do not exist yet
+	//	@thrCnt: number of threads
+	//	@all: if true then build files for all chromosomes, otherwise for treated ones only
+	//	@prMsg: true if print message about service files generation
+	void	Prepare		(thrid thrCnt, bool all, bool prMsg) const;
 	
 	// Prints threated chroms short names
 	void	PrintTreatedChroms() const;
@@ -659,12 +671,35 @@ public:
 
 #endif	// _ISCHIP
 
+// 'SeqArena' keeps the thread's reusable buffer of the chrom sequences:
+// it grows up to the largest chrom and is reused by the next ones,
+// so that the memory is not allocated and faulted in again at each chrom.
+// The buffer can be backed by transparent huge pages (Linux only).
+class SeqArena
+{
+	char*	_buff = NULL;	// buffer
+	size_t	_size = 0;		// buffer's size
+
+	// Releases buffer
+	void Free();
+
+public:
+	static bool HugePages;	// true if buffer is backed by transparent huge pages
+
+	inline ~SeqArena() { Free(); }
+
+	// Returns buffer of at least the given size; the previous content is not kept
+	//	@size: required size in bytes
+	char* Get(size_t size);
+};
+
 // 'RefSeq' represented reference chromosome as an array of nucleotides
 class RefSeq
 {
 private:
 	chrid	_ID;			// chrom ID
 	char*	_seq = NULL;	// the nucleotides buffer
+	SeqArena* _arena = NULL;// owner of the nucleotides buffer, or NULL if buffer is own
 	chrlen	_len,			// length of chromosome
 			_gapLen;		// total length of gaps
 	Region	_effDefRgn;		// effective defined region (except 'N' at the begining and at the end)
@@ -680,7 +715,7 @@ public:
 	static bool	LetGaps;	// if true then include gaps at the edges of the ref chrom while reading
 	static bool	StatGaps;	// if true count sum gaps for statistic output
 
-	inline ~RefSeq()	{ delete [] _seq; }
+	inline ~RefSeq()	{ if(!_arena)	delete [] _seq; }
 
 	// Gets chrom legth
 	inline chrlen Length()	const { return _len; }
@@ -693,6 +728,9 @@ public:
 	// Gets subsequence without exceeding checking 
 	inline const char* Seq(chrlen pos) const { return _seq + pos; }
 
+	// Returns true if nucleotides are loaded
+	inline bool IsFilled() const { return _seq != NULL; }
+
 #if defined _ISCHIP || defined _VALIGN
 
 	// Creates a stub instance (for sampling cutting)
@@ -701,7 +739,12 @@ public:
 	{ _effDefRgn.Set(0, len); }
 
 	// Creates and fills new instance
-	RefSeq(chrid cID, const ChromSizes& cSizes);
+	//	@cID: chrom ID
+	//	@cSizes: chrom sizes
+	//	@fill: if false then nucleotides are not loaded (sequence-free mode):
+	//	FA file is read only if chrom's defined regions are not saved yet
+	//	@arena: thread's buffer keeper to place the nucleotides, or NULL to allocate own buffer
+	RefSeq(chrid cID, const ChromSizes& cSizes, bool fill = true, SeqArena* arena = NULL);
 
 #endif
 #ifdef _ISCHIP
@@ -804,6 +847,32 @@ public:
 
 typedef pair<float, float> fpair;
 
+// 'LenHist' represents a fragment's/read's length frequency histogram filled by a single thread.
+// Lengths are counted in a flat array indexed by length; rare long lengths go to the overflow buckets.
+class LenHist
+{
+	static const fraglen Capacity = 1 << 13;	// number of lengths counted in a flat array
+
+	vector<ULONG>		_freqs;		// frequencies indexed by length
+	map<fraglen,ULONG>	_over;		// overflow buckets: frequencies of lengths beyond the array
+
+public:
+	inline LenHist() : _freqs(Capacity, 0) {}
+
+	// Adds fragment/read to histogram
+	//	@len: frag's length
+	inline void AddLen(fraglen len) { if (len < Capacity) _freqs[len]++; else _over[len]++; }
+
+	// Calls functor for each length with nonzero frequency in ascending order
+	//	@f: functor with (fraglen len, ULONG freq) parameters
+	template<typename Functor>
+	void DoWithFreq(Functor f) const {
+		for (fraglen len = 0; len < Capacity; len++)
+			if (_freqs[len])	f(len, _freqs[len]);
+		for (const auto& fr : _over)	f(fr.first, fr.second);
+	}
+};
+
 // 'LenFreq' represents a fragment's/read's length frequency statistics
 class LenFreq : map<fraglen,ULONG>
 {
@@ -1055,6 +1124,10 @@ public:
 	//	@len: frag's length
 	inline void AddLen(fraglen len) { (*this)[len]++; }
 
+	// Adds histogram to statistics
+	//	@hist: added histogram
+	void Add(const LenHist& hist) { hist.DoWithFreq([this](fraglen len, ULONG freq) { (*this)[len] += freq; }); }
+
 	// Calculate and print dist fpair
 	//	@s: print stream
 	//	@type: combined type of distribution
@@ -1065,14 +1138,53 @@ public:
 #endif	// _ISCHIP
 #if defined _ISCHIP || defined _BSDEC
 
-using coval = UINT;					// coverage value
-using covmap = map<chrlen, coval>;	// coverage map
+using coval = UINT;		// coverage value
+using codelta = int;	// coverage increment (delta) value
 
 // 'AccumCover' represents cumulative chrom's fragment coverage data
-//	and implements a single method for gradual filling (incrementing) coverage
-class AccumCover : public covmap
+//	and implements a single method for gradual filling (incrementing) coverage.
+//	Coverage is kept as deltas split into lazily allocated blocks,
+//	so each fragment is added by two O(1) increments.
+//	A block keeps the unsorted list of added deltas while it is sparse,
+//	and turns into the flat array when the list reaches the size of the array.
+//	The coverage itself is restored by a single prefix-sum pass while reading.
+class AccumCover
 {
-	bool _unsaved = true;	// true if data is still unsaved
+	static const BYTE	BlockBits = 12;						// binary logarithm of block length
+	static const chrlen	BlockLen = chrlen(1) << BlockBits;	// number of positions in block
+
+	using item = pair<USHORT, codelta>;		// delta's offset in block, delta's value
+
+	// Maximum number of items in sparse block
+	static const chrlen	SparseLen = BlockLen * sizeof(codelta) / sizeof(item);
+
+	struct Block {
+		vector<codelta>	Dense;		// flat array of deltas, or empty while the block is sparse
+		vector<item>	Sparse;		// unsorted list of deltas while the block is sparse
+
+		// Adds delta
+		//	@offset: delta's offset in block
+		//	@val: delta's value
+		void Add(USHORT offset, codelta val);
+
+		// Adds another block
+		void Add(const Block& blk);
+	};
+
+	vector<Block> _blocks;		// delta blocks; block not touched yet is empty
+	string	_spillName;			// temporary file keeping spilled data, or empty
+	bool _unsaved = true;		// true if data is still unsaved
+
+protected:
+	// Adds delta at given position; allocates the block if needed
+	//	@pos: delta's position
+	//	@val: delta's value
+	void AddDelta(chrlen pos, codelta val)
+	{
+		const size_t ind = pos >> BlockBits;
+		if (ind >= _blocks.size())	_blocks.resize(ind + 1);
+		_blocks[ind].Add(USHORT(pos & (BlockLen - 1)), val);
+	}
 
 public:
 	bool Closed = false;
@@ -1080,46 +1192,103 @@ public:
 	// Default constructor
 	inline AccumCover() {}
 
-	// Copy constructor
-	inline AccumCover(const AccumCover& cv) : covmap(cv) { }
+	// Data may be spilled to a temporary file removed by destructor, so the instance is move-only
+	AccumCover(const AccumCover&) = delete;
+	AccumCover& operator=(const AccumCover&) = delete;
+
+	// Move constructor
+	inline AccumCover(AccumCover&& cv) noexcept : _blocks(move(cv._blocks)),
+		_spillName(move(cv._spillName)), _unsaved(cv._unsaved), Closed(cv.Closed)
+	{ cv._spillName.clear(); }
+
+	// Move assignment
+	AccumCover& operator=(AccumCover&& cv) noexcept;
+
+	// Removes temporary file if data was spilled but never restored
+	~AccumCover() { if (IsSpilled())	remove(_spillName.c_str()); }
 
 	// Returns true if data is unsaved
 	inline bool Unsaved() const { return _unsaved; }
 
 	// Clears data and mark it as saved
-	void Clear() { _unsaved = false; clear(); }
+	void Clear() { _unsaved = false; vector<Block>().swap(_blocks); }
 
 	// Adds fragment to accumulate the coverage
-	void AddRegion(const Region& frag);
+	inline void AddRegion(const Region& frag) { AddDelta(frag.Start, 1); AddDelta(frag.End, -1); }
+
+	// Adds another coverage of the same chrom
+	//	@cv: added coverage
+	void Add(const AccumCover& cv);
+
+	// Returns size of allocated data in bytes
+	size_t MemSize() const;
+
+	// Returns true if data is kept in temporary file
+	inline bool IsSpilled() const { return !_spillName.empty(); }
+
+	// Saves data to temporary file as the list of nonzero deltas and releases memory
+	//	@fName: temporary file name
+	void Spill(const string& fName);
+
+	// Restores spilled data and removes temporary file
+	void Unspill();
 
-	// Calls functor for each point that put the chrom coverage
+	// Calls functor for each position with nonzero delta
+	//	@f: functor with (chrlen pos, codelta val) parameters
 	template<typename Functor>
 	void DoWithItem(Functor f) const {
-		for (const value_type& item : *this)	f(item);
+		vector<item> items;		// sorted items of sparse block
+
+		for (size_t i = 0; i < _blocks.size(); i++) {
+			const Block& block = _blocks[i];
+			const chrlen shift = chrlen(i) << BlockBits;
+
+			if (block.Dense.size()) {
+				for (chrlen k = 0; k < BlockLen; k++)
+					if (block.Dense[k])	f(shift + k, block.Dense[k]);
+				continue;
+			}
+			if (block.Sparse.empty())	continue;
+			items = block.Sparse;
+			sort(items.begin(), items.end(),
+				[](const item& it1, const item& it2) { return it1.first < it2.first; });
+			// merge deltas with the same offset
+			for (auto it = items.begin(); it != items.end();) {
+				const USHORT offset = it->first;
+				codelta val = 0;
+				for (; it != items.end() && it->first == offset; it++)	val += it->second;
+				if (val)	f(shift + offset, val);
+			}
+		}
 	}
 
-	// Calls functor for each point that put the chrom coverage
+	// Calls functor for each region with a constant nonzero coverage
+	//	@f: functor with (chrlen start, chrlen end, coval val) parameters
 	template<typename Functor>
-	void DoWith2Items(Functor f) const {
-		auto it0 = cbegin(), it = it0;		// previous, current entry
-
-		for (++it; it != end(); it0 = it++)
-			if (it0->second)	f(it0, it);
+	void DoWithRegions(Functor f) const {
+		chrlen start = 0;	// start of current region
+		coval val = 0;		// coverage of current region
+
+		DoWithItem([&](chrlen pos, codelta delta) {
+			if (val)	f(start, pos, val);
+			val += delta;
+			start = pos;
+		});
 	}
 
 #ifdef _DEBUG
 	void WigPrint() const
 	{
 		cout << "pos\tval\n";
-		DoWithItem([](const auto& item) { cout << item.first << TAB << item.second << LF; });
+		DoWithItem([](chrlen pos, codelta val) { cout << pos << TAB << val << LF; });
 	}
 
 	// Prints output in BedGraph format
 	void BgPrint() const
 	{
 		cout << "start\tend\tval\n";
-		DoWith2Items([](const auto& it0, const auto& it1)
-			{ cout << it0->first << TAB << it1->first << TAB << it0->second << LF; }
+		DoWithRegions([](chrlen start, chrlen end, coval val)
+			{ cout << start << TAB << end << TAB << val << LF; }
 		);
 	}
 #endif	// _DEBUG
@@ -593,6 +593,9 @@ public:
 
 	inline static bool IsPosInName() { return PosInName; }
 
+	// Returns true if N-limit is set
+	inline static bool IsNLimit() { return LimitN != readlen(vUNDEF); }
+
 	// Fills external buffer by quality values for the sequence
 	inline static void FillBySeqQual(char* dst, readlen rlen) { memset(dst, SeqQuality, rlen); }
 
@@ -8,6 +8,7 @@ Provides output data text files functionality
 ***********************************************************/
 
 #include "DataOutFile.h"
+#include <thread>
 
 const char* GM::title[] = {"test","control"};	// title: printed member's name
 
@@ -519,6 +520,73 @@ void SamOutFile::AddTwoReads(const Read& read1, const Read& read2, int fLen)
 
 /************************ class SamOutFile: end ************************/
 
+/************************ class CoverOutFile ************************/
+
+size_t	CoverOutFile::MemLimit = 0;			// maximum size of closed data waiting for writing
+bool	CoverOutFile::BigWig = false;		// true if coverage and density are written in bigWig format
+atomic<size_t> CoverOutFile::HeldSize(0);	// total size of closed data waiting for writing
+
+// Creates new instance
+//	@tmpName: common part of temporary files name
+//	@mtype: mutex locker type
+//	@cSizes: chrom sizes
+CoverOutFile::CoverOutFile(const string& tmpName, Mutex::eType mtype, const ChromSizesExt& cSizes)
+	: _tmpName(tmpName), _mType(mtype)
+{
+	for (const auto& cs : cSizes)
+		if (cs.second.Treated)
+			AddEmptyElem(cs.first);
+	_unsaved = Begin();
+}
+
+// Creates new strand-separated instance
+//	@strandInd: strand index: 0 - positive, 1 - negative
+//	@tmpName: common part of temporary files name
+//	@file: united strands file
+CoverOutFile::CoverOutFile(int strandInd, const string& tmpName, const CoverOutFile& file)
+	: _tmpName(tmpName), _mType(Mutex::eType(int(Mutex::eType::WR_BG) + strandInd))
+{
+	for (const auto& c : file.Container())		// coverages are move-only, so add empty ones
+		AddEmptyElem(c.first).Treated = c.second.Treated;
+	_unsaved = Begin();
+}
+
+// Close data container for given chrom for increment.
+//	@cID: chrom ID
+void CoverOutFile::CloseChromData(chrid cID)
+{
+	// AccumCovers are created and filled in different threads independently.
+	// To save them in chrom sorted order the pool is examined from the first unsaved coverage
+	// each time the next coverage is completed.
+	// All closed coverages following without gaps are recorded and removed from the pool,
+	// so each coverage is visited once regardless of the number of chroms.
+
+	// A coverage that cannot be recorded yet is kept in memory until the total size of such coverages
+	// in all files exceeds the limit; then it is spilled to temporary file in the output folder
+	// and restored when its turn comes, so the memory does not grow with the genome size.
+
+	PrepareChromData(cID);		// chrom's data is filled by this thread only
+	Mutex::Lock(_mType);		// different mutexes for different WIG files
+	auto& data = At(cID).Data;
+	data.Closed = true;
+	if (CID(_unsaved) != cID) {
+		const size_t size = data.MemSize();
+		if (MemLimit && size && HeldSize + size > MemLimit)
+			data.Spill(FS::TmpFileName(_tmpName + ".chr" + Chrom::Mark(cID)));
+		else
+			HeldSize += size;
+	}
+	for (; _unsaved != End() && _unsaved->second.Data.Closed; _unsaved++) {
+		auto& d = _unsaved->second.Data;
+		if (d.IsSpilled())		d.Unspill();
+		else if (CID(_unsaved) != cID)	HeldSize -= d.MemSize();
+		WriteChromData(CID(_unsaved));
+	}
+	Mutex::Unlock(_mType);
+}
+
+/************************ class CoverOutFile: end ************************/
+
 /************************ class WigOutFile ************************/
 
 const string WigOutFile::WigFormats[] = { "bedGraph", "wiggle_0" };
@@ -555,39 +623,9 @@ WigOutFile::WigOutFile(
 	const char* descr,
 	Mutex::eType mtype,
 	const ChromSizesExt& cSizes
-)	: _mType(mtype), TxtOutFile(ftype, fName, TAB)
+)	: CoverOutFile(fName, mtype, cSizes), TxtOutFile(ftype, fName, TAB)
 {
 	Init(ftype, fName, descr);
-	for (const auto& cs : cSizes)
-		if (cs.second.Treated)
-			AddElem(cs.first, DensCover());
-}
-
-// Close data container for given chrom for increment.
-//	@cID: chrom ID
-void WigOutFile::CloseChromData(chrid cID)
-{
-	// AccumCovers are created and filled in different threads independently.
-	// To save them in chrom sorted order the total pool is examined 
-	// each time the next coverage is completed.
-	// If previous coveraged are filled without gups, they are recorded and removed from the pool.
-
-	Mutex::Lock(_mType);		// different mutexes for different WIG files
-	bool save = true;
-	At(cID).Data.Closed = true;
-	for (cIter it = Begin(); CID(it) < cID; it++)
-		if (it->second.Data.Unsaved())
-			if (save = it->second.Data.Closed)	// chrom cover is closed, so save it
-				WriteChromData(CID(it));
-			else 	break;						// some of chrom covers aren't saved
-	//for (auto& c : Container())
-	//	if (c.second.Data.Unsaved())
-	//		if (save = c.second.Data.Closed)	// chrom cover is closed, so save it
-	//			WriteChromData(c.first);
-	//		else 	break;						// some of chrom covers aren't saved
-	if (save)
-		WriteChromData(cID);
-	Mutex::Unlock(_mType);
 }
 
 /************************ class WigOutFile: end ************************/
@@ -604,18 +642,11 @@ void BedGrOutFiles::BedGrOutFile::WriteChromData(chrid cID)
 	const rowlen offset = LineAddStr(Chrom::AbbrName(cID));
 
 	auto& d = At(cID).Data;				// not const because of d.Clear() at the end
-	auto it0 = d.cbegin(), it = it0;
-	const auto end = d.cend();
-
-	for (++it; it != end; it0 = it++)
-		if (it0->second)
-			LineAddInts(it0->first, it->first, it0->second, false),		// start, end, coverage
-			LineToIOBuff(offset);
-
-	//d.DoWith2Items([&](const auto& it0, const auto& it) {
-	//	LineAddInts(it0->first, it->first, it0->second, false);		// start, end, coverage
-	//	LineToIOBuff(offset);
-	//	});
+
+	d.DoWithRegions([&](chrlen start, chrlen end, coval val) {
+		LineAddInts(start, end, val, false);		// start, end, coverage
+		LineToIOBuff(offset);
+	});
 	d.Clear();
 }
 
@@ -626,7 +657,7 @@ void BedGrOutFiles::BedGrOutFile::WriteChromData(chrid cID)
 bool BedGrOutFiles::IsStrands;		// true if wigs with different strands should be generated
 
 	// Applies function fn to each of the item in _files
-void BedGrOutFiles::DoForFiles(function<void(BedGrOutFiles::BedGrOutFile*)> fn)
+void BedGrOutFiles::DoForFiles(function<void(CoverOutFile*)> fn)
 {
 	for (BYTE i = !IsStrands * (Count - 1); i < Count; i++)	// last item (basic) or all ones (plus strands)
 		fn(_files[i]);
@@ -637,20 +668,42 @@ void BedGrOutFiles::DoForFiles(function<void(BedGrOutFiles::BedGrOutFile*)> fn)
 //	@cSizes: chrom sizes
 BedGrOutFiles::BedGrOutFiles(const string& fName, const ChromSizesExt& cSizes)
 {
-	_files[Count-1] = new BedGrOutFile(fName, cSizes);
-	if(IsStrands)
-		_files[0] = new BedGrOutFile(0, fName + "_pos", *_files[Count-1]),
-		_files[1] = new BedGrOutFile(1, fName + "_neg", *_files[Count-1]);
+	if (CoverOutFile::BigWig) {
+		BigWigOutFile* total = new BigWigOutFile(fName, false, Mutex::eType::WR_BG, cSizes);
+		_files[Count-1] = total;
+		if(IsStrands)
+			_files[0] = new BigWigOutFile(0, fName + "_pos", *total),
+			_files[1] = new BigWigOutFile(1, fName + "_neg", *total);
+	}
+	else {
+		BedGrOutFile* total = new BedGrOutFile(fName, cSizes);
+		_files[Count-1] = total;
+		if(IsStrands)
+			_files[0] = new BedGrOutFile(0, fName + "_pos", *total),
+			_files[1] = new BedGrOutFile(1, fName + "_neg", *total);
+	}
+}
+
+// Starts accumalating coverage for given chrom
+//	@cID: chrom
+//	@covers: coverages to be filled by fragments: [0] - pos strand, [1] - neg strand;
+//	both are the total coverage if strands are not set
+void BedGrOutFiles::OpenChrom(chrid cID, DensCover* covers[2])
+{
+	for (BYTE i = 0; i < 2; i++)
+		covers[i] = &_files[IsStrands ? i : Count - 1]->ChromData(cID);
 }
 
-// Adds SE fragment to total coverage, and strand coverage if set
-//	@frag: added fragment
-//	@reverse: true if read is reversed (neg strand)
-void BedGrOutFiles::AddFrag(const Region& frag, bool reverse)
+// Stops accumalating coverage for given chrom
+void BedGrOutFiles::CloseChrom(chrid cID)
 {
-	_files[Count - 1]->AddFragCov(frag);
-	if(_files[0])
-		_files[reverse]->AddFragCov(frag);
+	// total coverage is not filled by fragments when strands are set: derive it from the strands
+	if (IsStrands) {
+		DensCover& total = _files[Count - 1]->ChromData(cID);
+		total.Add(_files[0]->ChromData(cID));
+		total.Add(_files[1]->ChromData(cID));
+	}
+	DoForFiles([&cID](CoverOutFile* f) { f->CloseChromData(cID); });
 }
 
 // Prints output file names separated by comma
@@ -666,23 +719,645 @@ void BedGrOutFiles::PrintNames() const
 
 /************************ class Wig0OutFile ************************/
 
+chrlen DensCover::BinLen = 1;			// density bin length
+bool Wig0OutFile::FixedStep = false;	// true if density is written in fixedStep format
+
 // Fill IO buffer by chrom data
 void Wig0OutFile::WriteChromData(chrid cID)
 {
-	// write declaration line
+	const chrlen binLen = DensCover::BinLen;
+	const string span = " span=" + to_string(binLen);
+	auto& d = At(cID).Data;
+
 	LineSetOffset();
-	StrToIOBuff("variableStep chrom=chr" + Chrom::Mark(cID) + " span=1");
+	if (FixedStep) {
+		const string decl = "fixedStep chrom=chr" + Chrom::Mark(cID) + " start=";
+		const string step = " step=" + to_string(binLen) + span;
+		chrlen next = 0;		// index of the bin following the last written one
+		bool isSection = false;	// true if fixedStep section is opened
+
+		// write data lines; zero bins inside the section are written explicitly
+		d.DoWithItem([&](chrlen ind, codelta freq) {
+			if (!isSection || ind - next > MaxZeroRun) {
+				StrToIOBuff(decl + to_string(ind * binLen) + step);		// section declaration line
+				isSection = true;
+			}
+			else
+				for (; next < ind; next++) {
+					LineAddInt(0, false);
+					LineToIOBuff();
+				}
+			LineAddInt(freq, false);
+			LineToIOBuff();
+			next = ind + 1;
+		});
+	}
+	else {
+		// write declaration line
+		StrToIOBuff("variableStep chrom=chr" + Chrom::Mark(cID) + span);
+
+		// write data lines
+		d.DoWithItem([this, binLen](chrlen ind, codelta freq) {
+			LineAddInts(ind * binLen, freq, false);	// pos, freq
+			LineToIOBuff();
+		});
+	}
+	d.Clear();
+}
+
+/************************ class Wig0OutFile: end ************************/
+
+/************************ class BigWigOutFile ************************/
+
+// Adds value to the binary buffer
+//	@buf: buffer
+//	@val: added value
+template<typename T>
+void PutVal(string& buf, T val) { buf.append((const char*)&val, sizeof(T)); }
+
+// Writes block to file
+//	@data: pointer to the block
+//	@size: size of the block
+void BigWigOutFile::Write(const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, _file) != size)	Err(Err::F_WRITE, _fName.c_str()).Throw();
+	_offset += size;
+}
+
+// Adds item
+//	@len: item length
+//	@val: item value
+void BigWigOutFile::Summary::Add(chrlen len, float val)
+{
+	if (!BasesCovered || val < MinVal)	MinVal = val;
+	if (!BasesCovered || val > MaxVal)	MaxVal = val;
+	BasesCovered += len;
+	SumData += double(val) * len;
+	SumSquares += double(val) * val * len;
+}
+
+// Adds another summary
+void BigWigOutFile::Summary::Add(const Summary& s)
+{
+	if (!s.BasesCovered)	return;
+	if (!BasesCovered || s.MinVal < MinVal)	MinVal = s.MinVal;
+	if (!BasesCovered || s.MaxVal > MaxVal)	MaxVal = s.MaxVal;
+	BasesCovered += s.BasesCovered;
+	SumData += s.SumData;
+	SumSquares += s.SumSquares;
+}
+
+// Opens file, writes header placeholder and chrom tree; common part of the constructors
+void BigWigOutFile::Open()
+{
+	if (!(_file = fopen(_fName.c_str(), "wb")))	Err(Err::F_OPEN, _fName.c_str()).Throw();
+
+	// header, zoom headers and total summary are written on closing
+	Write(string(HeaderSize + ZoomCount * ZoomHeaderSize + SummarySize, 0));
+
+	// chrom B+ tree with the single leaf node; chrom index is the order of recording
+	const UINT cnt = UINT(_cLens.size());
+	UINT keySize = 1;
+	for (auto it = cBegin(); it != cEnd(); it++)
+		keySize = max(keySize, UINT(Chrom::AbbrName(CID(it)).length()));
+	string buf;
+	PutVal(buf, UINT(0x78CA8C91));		// B+ tree signature
+	PutVal(buf, max(cnt, UINT(1)));		// block size
+	PutVal(buf, keySize);
+	PutVal(buf, UINT(2 * sizeof(UINT)));// value size
+	PutVal(buf, ULLONG(cnt));			// item count
+	PutVal(buf, ULLONG(0));				// reserved
+	PutVal(buf, BYTE(1));				// is leaf
+	PutVal(buf, BYTE(0));				// reserved
+	PutVal(buf, uint16_t(cnt));			// count of items
+	UINT ix = 0;
+	_chromIxs.resize(cnt ? size_t(CID(prev(cEnd()))) + 1 : 0);
+	_chunks.resize(cnt);
+	for (auto it = cBegin(); it != cEnd(); it++, ix++) {
+		_chromIxs[CID(it)] = ix;
+		string key = Chrom::AbbrName(CID(it));
+		key.resize(keySize, 0);
+		buf += key;
+		PutVal(buf, ix);
+		PutVal(buf, _cLens[ix]);
+	}
+	Write(buf);
+
+	_dataOffset = _offset;
+	Write(string(sizeof(ULLONG), 0));	// count of sections is written on closing
+
+	chrlen reduction = ZoomBase;
+	for (BYTE i = 0; i < ZoomCount; reduction <<= 2, i++) {
+		_zooms[i].Reduction = reduction;
+		for (Chunk& c : _chunks)	c.Zooms[i].Reduction = reduction;
+	}
+}
+
+// Creates new instance for writing
+//	@fName: file name without extention
+//	@dens: true if density is recorded, otherwise coverage
+//	@mtype: mutex locker type
+//	@cSizes: chrom sizes
+BigWigOutFile::BigWigOutFile(const string& fName, bool dens, Mutex::eType mtype, const ChromSizesExt& cSizes)
+	: CoverOutFile(fName, mtype, cSizes), _fName(fName + ".bw"), _dens(dens)
+{
+	for (const auto& cs : cSizes)
+		if (cs.second.Treated)
+			_cLens.push_back(cs.second.Data.Real);
+	Open();
+}
+
+// Creates new strand-separated coverage instance for writing
+//	@strandInd: strand index: 0 - positive, 1 - negative
+//	@fName: file name without extention
+//	@file: united strands file
+BigWigOutFile::BigWigOutFile(int strandInd, const string& fName, const BigWigOutFile& file)
+	: CoverOutFile(strandInd, fName, file), _fName(fName + ".bw"), _dens(false), _cLens(file._cLens)
+{
+	Open();
+}
+
+// Compresses sections
+//	@sects: sections to be compressed in place
+//	@maxRawSize: maximum uncompressed section size to be updated
+void BigWigOutFile::Compress(vector<string*>& sects, UINT& maxRawSize)
+{
+	for (const string* s : sects)
+		if (s->size() > maxRawSize)	maxRawSize = UINT(s->size());
+#ifndef _NO_ZLIB
+	string res;
+	for (string* s : sects) {
+		uLongf len = compressBound(uLong(s->size()));
+		res.resize(len);
+		if (compress((Bytef*)&res[0], &len, (const Bytef*)s->data(), uLong(s->size())) != Z_OK)
+			Err("section compression failed", _fName.c_str()).Throw();
+		res.resize(len);
+		s->swap(res);
+	}
+#endif
+}
+
+// Completes current zoom summary record
+//	@z: zoom level
+//	@sects: completed sections to be filled
+void BigWigOutFile::CloseZoomRec(Zoom& z, vector<string*>& sects)
+{
+	if (!z.IsRec)	return;
+	if (z.Sect.empty())
+		z.SectBnd = { z.Rec.ChromIx, z.Rec.Start, z.Rec.ChromIx, z.Rec.End, 0, 0 };
+	z.SectBnd.End = z.Rec.End;
+	z.Sect.append((const char*)&z.Rec, sizeof(ZoomRec));
+	z.IsRec = false;
+	z.RecCnt++;
+	if (z.Sect.size() == ItemsPerSlot * sizeof(ZoomRec))	CloseZoomSect(z, sects);
+}
+
+// Completes current zoom section
+//	@z: zoom level
+//	@sects: completed sections to be filled
+void BigWigOutFile::CloseZoomSect(Zoom& z, vector<string*>& sects)
+{
+	if (z.Sect.empty())	return;
+	z.Sects.push_back(z.SectBnd);
+	z.Blobs.push_back(string());
+	z.Blobs.back().swap(z.Sect);
+	sects.push_back(&z.Blobs.back());
+}
+
+// Adds item to the zoom level summary
+//	@z: zoom level
+//	@start: item start
+//	@end: item end
+//	@val: item value
+//	@sects: completed sections to be filled
+void BigWigOutFile::AddToZoom(Zoom& z, UINT ix, chrlen start, chrlen end, float val, vector<string*>& sects)
+{
+	while (start < end) {
+		const chrlen binStart = start - start % z.Reduction;
+		const chrlen binEnd = min(binStart + z.Reduction, _cLens[ix]);
+		const chrlen len = min(end, binEnd) - start;
+
+		if (z.IsRec && z.Rec.Start != binStart)	CloseZoomRec(z, sects);
+		if (!z.IsRec) {
+			z.Rec = { ix, binStart, binEnd, 0, val, val, 0, 0 };
+			z.IsRec = true;
+		}
+		z.Rec.ValidCnt += len;
+		if (val < z.Rec.Min)	z.Rec.Min = val;
+		if (val > z.Rec.Max)	z.Rec.Max = val;
+		z.Rec.Sum += val * len;
+		z.Rec.SumSquares += val * val * len;
+		start += len;
+	}
+}
+
+// Builds and compresses chrom's sections outside the file lock
+void BigWigOutFile::PrepareChromData(chrid cID)
+{
+	const UINT ix = _chromIxs[cID];
+	Chunk& c = _chunks[ix];			// is filled only by this thread
+	vector<string>& data = c.Data;	// full data sections
+	vector<Bounds>& bounds = c.Bnds;// full data sections bounds
+	vector<string*> sects;			// all sections to be compressed
+	string sect;					// current full data section
+	UINT itemCnt = 0;				// number of items in the current full data section
+
+	// closes current full data section
+	auto closeSect = [&]() {
+		if (!itemCnt)	return;
+		uint16_t* cnt = (uint16_t*)&sect[5 * sizeof(UINT) + 2];
+		*cnt = uint16_t(itemCnt);
+		*(UINT*)&sect[2 * sizeof(UINT)] = bounds.back().End;
+		data.push_back(string());
+		data.back().swap(sect);
+		itemCnt = 0;
+	};
+	// adds item to the full data, summary and zoom levels
+	auto addItem = [&](chrlen start, chrlen end, float val) {
+		if (itemCnt == ItemsPerSlot)	closeSect();
+		if (!itemCnt) {
+			PutVal(sect, ix);				// chrom index
+			PutVal(sect, start);			// start
+			PutVal(sect, end);				// end; is corrected on closing
+			PutVal(sect, UINT(0));			// item step
+			PutVal(sect, UINT(0));			// item span
+			PutVal(sect, BYTE(1));			// type: bedGraph
+			PutVal(sect, BYTE(0));			// reserved
+			PutVal(sect, uint16_t(0));		// item count; is corrected on closing
+			bounds.push_back({ ix, start, ix, end, 0, 0 });
+		}
+		bounds.back().End = end;
+		PutVal(sect, start);
+		PutVal(sect, end);
+		PutVal(sect, val);
+		itemCnt++;
+
+		c.Summ.Add(end - start, val);
+		for (Zoom& z : c.Zooms)
+			AddToZoom(z, ix, start, end, val, sects);
+	};
 
-	// write data lines
 	auto& d = At(cID).Data;
-	for (const auto& f : d) {					// frequency
-		LineAddInts(f.first, f.second, false);	// pos, freq
-		LineToIOBuff();
+	if (_dens) {
+		const chrlen binLen = DensCover::BinLen;
+		const chrlen cLen = _cLens[ix];
+		d.DoWithItem([&](chrlen ind, codelta freq) {
+			const chrlen start = ind * binLen;
+			addItem(start, min(start + binLen, cLen), float(freq));
+		});
 	}
+	else
+		d.DoWithRegions([&](chrlen start, chrlen end, coval val) { addItem(start, end, float(val)); });
 	d.Clear();
+	closeSect();
+
+	// zoom records and sections do not cross chroms
+	for (Zoom& z : c.Zooms)
+		CloseZoomRec(z, sects),
+		CloseZoomSect(z, sects);
+	for (string& s : data)	sects.push_back(&s);
+	Compress(sects, c.MaxRawSize);
 }
 
-/************************ class Wig0OutFile: end ************************/
+// Records chrom's prepared data
+void BigWigOutFile::WriteChromData(chrid cID)
+{
+	Chunk& c = _chunks[_chromIx];
+
+	for (size_t i = 0; i < c.Data.size(); i++) {
+		c.Bnds[i].Offset = _offset;
+		c.Bnds[i].Size = c.Data[i].size();
+		Write(c.Data[i]);
+	}
+	_sects.insert(_sects.end(), c.Bnds.begin(), c.Bnds.end());
+	for (BYTE i = 0; i < ZoomCount; i++) {
+		Zoom& z = _zooms[i];
+		Zoom& cz = c.Zooms[i];
+
+		z.RecCnt += cz.RecCnt;
+		z.Sects.insert(z.Sects.end(), cz.Sects.begin(), cz.Sects.end());
+		for (string& s : cz.Blobs) {
+			z.Blobs.push_back(string());
+			z.Blobs.back().swap(s);
+		}
+	}
+	_summ.Add(c.Summ);
+	if (c.MaxRawSize > _maxRawSize)	_maxRawSize = c.MaxRawSize;
+	c = Chunk();	// release memory
+	_chromIx++;
+}
+
+// Writes R-tree index
+//	@sects: indexed sections
+void BigWigOutFile::WriteIndex(const vector<Bounds>& sects)
+{
+	const BYTE headerSize = 48;
+	const BYTE nodeHeaderSize = 4;
+	const BYTE leafItemSize = 32;
+	const BYTE nodeItemSize = 24;
+
+	// levels[0] are sections, levels[i] are nodes grouping up to BlockSize items of levels[i-1];
+	// the last level contains the single root node. Bounds::Size of the node keeps its count of items
+	vector<vector<Bounds>> levels(1, sects);
+	do {
+		const vector<Bounds>& items = levels.back();
+		vector<Bounds> nodes;
+
+		for (size_t i = 0; i < items.size() || !i; i += BlockSize) {
+			const size_t last = min(i + BlockSize, items.size());
+			if (last)	nodes.push_back({ items[i].StartIx, items[i].Start, 
+							items[last - 1].EndIx, items[last - 1].End, 0, last - i });
+			else		nodes.push_back({ 0, 0, 0, 0, 0, 0 });
+		}
+		levels.push_back(move(nodes));
+	} while (levels.back().size() > 1);
+
+	// define nodes offsets from the root to the leaves
+	ULLONG offset = _offset + headerSize;
+	for (size_t k = levels.size() - 1; k; k--)
+		for (Bounds& node : levels[k])
+			node.Offset = offset,
+			offset += nodeHeaderSize + node.Size * (k == 1 ? leafItemSize : nodeItemSize);
+
+	const Bounds& root = levels.back()[0];
+	string buf;
+	PutVal(buf, UINT(0x2468ACE0));		// R-tree signature
+	PutVal(buf, BlockSize);
+	PutVal(buf, ULLONG(sects.size()));	// item count
+	PutVal(buf, root.StartIx);
+	PutVal(buf, root.Start);
+	PutVal(buf, root.EndIx);
+	PutVal(buf, root.End);
+	PutVal(buf, _offset);				// end of indexed data
+	PutVal(buf, ItemsPerSlot);
+	PutVal(buf, UINT(0));				// reserved
+	for (size_t k = levels.size() - 1; k; k--) {
+		size_t child = 0;
+		for (const Bounds& node : levels[k]) {
+			PutVal(buf, BYTE(k == 1));		// is leaf
+			PutVal(buf, BYTE(0));			// reserved
+			PutVal(buf, uint16_t(node.Size));
+			for (size_t n = 0; n < node.Size; n++) {
+				const Bounds& b = levels[k - 1][child++];
+				PutVal(buf, b.StartIx);
+				PutVal(buf, b.Start);
+				PutVal(buf, b.EndIx);
+				PutVal(buf, b.End);
+				PutVal(buf, b.Offset);
+				if (k == 1)	PutVal(buf, b.Size);
+			}
+		}
+	}
+	Write(buf);
+}
+
+// Writes indexes and header, closes file
+BigWigOutFile::~BigWigOutFile()
+{
+	if (!_file)	return;
+	try {
+		const ULLONG indexOffset = _offset;
+		ULLONG zoomOffsets[ZoomCount][2];	// zoom data and index offsets
+		BYTE zCnt = 0;						// number of recorded zoom levels
+
+		WriteIndex(_sects);
+		// level which does not reduce the previous one completes the zooms
+		for (Zoom& z : _zooms) {
+			if (!z.RecCnt || (zCnt && z.RecCnt == _zooms[zCnt - 1].RecCnt))	break;
+			zoomOffsets[zCnt][0] = _offset;
+			Write(&z.RecCnt, sizeof(z.RecCnt));
+			for (size_t i = 0; i < z.Blobs.size(); i++) {
+				z.Sects[i].Offset = _offset;
+				z.Sects[i].Size = z.Blobs[i].size();
+				Write(z.Blobs[i]);
+			}
+			z.Blobs.clear();
+			zoomOffsets[zCnt][1] = _offset;
+			WriteIndex(z.Sects);
+			zCnt++;
+		}
+		const UINT magic = Magic;
+		Write(&magic, sizeof(magic));
+
+		// header
+		const ULLONG summaryOffset = HeaderSize + ZoomCount * ZoomHeaderSize;
+		string buf;
+		PutVal(buf, magic);
+		PutVal(buf, uint16_t(4));				// version
+		PutVal(buf, uint16_t(zCnt));			// number of zoom levels
+		PutVal(buf, summaryOffset + SummarySize);	// chrom tree offset
+		PutVal(buf, _dataOffset);
+		PutVal(buf, indexOffset);
+		PutVal(buf, uint16_t(0));				// field count
+		PutVal(buf, uint16_t(0));				// defined field count
+		PutVal(buf, ULLONG(0));					// autoSql offset
+		PutVal(buf, summaryOffset);
+#ifdef _NO_ZLIB
+		PutVal(buf, UINT(0));					// uncompressed data
+#else
+		PutVal(buf, _maxRawSize);
+#endif
+		PutVal(buf, ULLONG(0));					// extension offset
+		for (BYTE i = 0; i < zCnt; i++) {
+			PutVal(buf, _zooms[i].Reduction);
+			PutVal(buf, UINT(0));				// reserved
+			PutVal(buf, zoomOffsets[i][0]);
+			PutVal(buf, zoomOffsets[i][1]);
+		}
+		buf.resize(size_t(summaryOffset), 0);
+		PutVal(buf, _summ.BasesCovered);
+		PutVal(buf, _summ.MinVal);
+		PutVal(buf, _summ.MaxVal);
+		PutVal(buf, _summ.SumData);
+		PutVal(buf, _summ.SumSquares);
+
+		fseek(_file, 0, SEEK_SET);
+		Write(buf);
+		fseek(_file, long(_dataOffset), SEEK_SET);
+		const ULLONG sectCnt = _sects.size();
+		Write(&sectCnt, sizeof(sectCnt));
+	}
+	catch (const Err& e) { cerr << e.what() << LF; }	// no exception from destructor
+	if (fclose(_file))	Err(Err::F_CLOSE, _fName.c_str()).Throw(false);
+}
+
+/************************ class BigWigOutFile: end ************************/
+
+// Sets file position; supports files larger than 2 Gb
+//	@file: opened file
+//	@offset: position from the beginning of file
+//	return: true if success
+static bool Seek(FILE* file, ULLONG offset)
+{
+#ifdef OS_Windows
+	return !_fseeki64(file, offset, SEEK_SET);
+#else
+	return !fseeko(file, off_t(offset), SEEK_SET);
+#endif
+}
+
+/************************ class RecOutFile ************************/
+
+const char* RecOutFile::Ext = ".rec";
+bool RecOutFile::Resume = false;
+
+// Leaves in existing file the blocks of the stated chroms only.
+//	@fName: file name without extention
+//	@cIDs: sorted IDs of the kept chroms
+void RecOutFile::Compact(const string& fName, const vector<chrid>& cIDs)
+{
+	const string name = fName + Ext;
+	const string tmpName = FS::TmpFileName(name);
+	{
+		unique_ptr<FILE, int(*)(FILE*)> iFile(fopen(name.c_str(), "rb"), fclose);
+		if (!iFile)	Err(Err::F_OPEN, name.c_str()).Throw();
+		unique_ptr<FILE, int(*)(FILE*)> oFile(fopen(tmpName.c_str(), "wb"), fclose);
+		if (!oFile)	Err(Err::F_OPEN, tmpName.c_str()).Throw();
+		Header header;
+		if (fread(&header, sizeof(Header), 1, iFile.get()) != 1 || header.Magic != Magic)
+			Err("wrong format of binary records", name).Throw();
+		if (fwrite(&header, sizeof(Header), 1, oFile.get()) != 1)	Err(Err::F_WRITE, tmpName.c_str()).Throw();
+
+		Block blk;
+		vector<Rec> recs;
+		// the last block may be truncated by interruption; it belongs to uncompleted chrom anyway
+		while (fread(&blk, sizeof(Block), 1, iFile.get()) == 1) {
+			recs.resize(blk.Count);
+			if (fread(recs.data(), sizeof(Rec), blk.Count, iFile.get()) != blk.Count)	break;
+			if (binary_search(cIDs.begin(), cIDs.end(), blk.cID)
+			&& (fwrite(&blk, sizeof(Block), 1, oFile.get()) != 1
+			|| fwrite(recs.data(), sizeof(Rec), blk.Count, oFile.get()) != blk.Count))
+				Err(Err::F_WRITE, tmpName.c_str()).Throw();
+		}
+	}
+	if (!FS::CommitFile(tmpName, name))	Err(Err::F_WRITE, name.c_str()).Throw();
+}
+
+// Creates new instance for writing, or continues existing file in the Resume mode
+//	@fName: file name without extention
+RecOutFile::RecOutFile(const string& fName) : _fName(fName + Ext), _primer(true)
+{
+	if (Resume && FS::IsFileExist(_fName.c_str())) {	// header is already written
+		if (!(_file = fopen(_fName.c_str(), "ab")))	Err(Err::F_OPEN, _fName.c_str()).Throw();
+	}
+	else {
+		const Header header{ Magic, Read::FixedLen, BYTE(Seq::IsPE()), BYTE(DistrParams::IsRVL()) };
+
+		if (!(_file = fopen(_fName.c_str(), "wb")))	Err(Err::F_OPEN, _fName.c_str()).Throw();
+		if (fwrite(&header, sizeof(Header), 1, _file) != 1)	Err(Err::F_WRITE, _fName.c_str()).Throw();
+	}
+	_recs.reserve(BlockCapacity);
+}
+
+RecOutFile::~RecOutFile()
+{
+	if (_sink)	return;
+	if (_primer && fclose(_file))
+		Err(Err::F_CLOSE, _fName.c_str()).Throw(false);		// no exception from destructor
+}
+
+// Writes buffered records as a block and flushes the file stream
+void RecOutFile::Flush()
+{
+	if (_recs.empty())	return;
+	if (_sink) {
+		_sink->Push({ _cID, _rep, _control, _recs.size(), _recs.data() });
+		_recs.clear();
+		return;
+	}
+	const Block blk{ _cID, 0, UINT(_recs.size()) };
+
+	Mutex::Lock(Mutex::eType::WR_REC);
+	const bool ok = fwrite(&blk, sizeof(Block), 1, _file) == 1
+		&& fwrite(_recs.data(), sizeof(Rec), _recs.size(), _file) == _recs.size()
+		&& !fflush(_file);
+	Mutex::Unlock(Mutex::eType::WR_REC);
+	_recs.clear();
+	if (!ok)	Err(Err::F_WRITE, _fName.c_str()).Throw();
+}
+
+/************************ class RecOutFile: end ************************/
+
+/************************ class RecInFile ************************/
+
+// Opens file, checks header and indexes blocks
+//	@fName: file name
+RecInFile::RecInFile(const string& fName) : _fName(fName)
+{
+	unique_ptr<FILE, int(*)(FILE*)> file(fopen(fName.c_str(), "rb"), fclose);
+	if (!file)	Err(Err::F_OPEN, fName.c_str()).Throw();
+	if (fread(&_header, sizeof(_header), 1, file.get()) != 1 || _header.Magic != RecOutFile::Magic)
+		Err("wrong format of binary records", fName).Throw();
+
+	ULLONG offset = sizeof(_header);
+	RecOutFile::Block blk;
+	while (fread(&blk, sizeof(blk), 1, file.get()) == 1) {
+		offset += sizeof(blk);
+		_blocks[blk.cID].push_back({ offset, blk.Count });
+		offset += ULLONG(blk.Count) * sizeof(Rec);
+		if (!Seek(file.get(), offset))	Err(Err::F_READ, fName.c_str()).Throw();
+	}
+	if (ferror(file.get()))	Err(Err::F_READ, fName.c_str()).Throw();
+}
+
+// Reads block records
+//	@file: opened file
+//	@blk: read block
+//	@recs: records to be filled
+void RecInFile::Read(FILE* file, const Block& blk, vector<Rec>& recs) const
+{
+	recs.resize(blk.Count);
+	if (!Seek(file, blk.Offset) || fread(recs.data(), sizeof(Rec), blk.Count, file) != blk.Count)
+		Err(Err::F_READ, _fName.c_str()).Throw();
+}
+
+// Writes chrom's blocks to the opened file
+//	@cID: chrom's ID, or Chrom::UnID for all chroms
+//	@oFile: opened output file
+//	@oName: output file name
+void RecInFile::CopyBlocks(chrid cID, FILE* oFile, const string& oName) const
+{
+	unique_ptr<FILE, int(*)(FILE*)> file(fopen(_fName.c_str(), "rb"), fclose);
+	if (!file)	Err(Err::F_OPEN, _fName.c_str()).Throw();
+	vector<Rec> recs;
+
+	for (const auto& b : _blocks)
+		if (cID == Chrom::UnID || b.first == cID)
+			for (const Block& blk : b.second) {
+				const RecOutFile::Block oBlk{ b.first, 0, blk.Count };
+
+				Read(file.get(), blk, recs);
+				if (fwrite(&oBlk, sizeof(oBlk), 1, oFile) != 1
+				|| fwrite(recs.data(), sizeof(Rec), recs.size(), oFile) != recs.size())
+					Err(Err::F_WRITE, oName.c_str()).Throw();
+			}
+}
+
+// Writes chrom's records into new file
+//	@cID: chrom's ID
+//	@fName: new file name
+void RecInFile::Extract(chrid cID, const string& fName) const
+{
+	const string tmpName = FS::TmpFileName(fName);
+	{
+		unique_ptr<FILE, int(*)(FILE*)> file(fopen(tmpName.c_str(), "wb"), fclose);
+		if (!file)	Err(Err::F_OPEN, tmpName.c_str()).Throw();
+		if (fwrite(&_header, sizeof(_header), 1, file.get()) != 1)	Err(Err::F_WRITE, tmpName.c_str()).Throw();
+		CopyBlocks(cID, file.get(), tmpName);
+	}
+	if (!FS::CommitFile(tmpName, fName))	Err(Err::F_WRITE, fName.c_str()).Throw();
+}
+
+// Appends all records to existing file with the same header
+//	@fName: existing file name
+void RecInFile::AppendTo(const string& fName) const
+{
+	unique_ptr<FILE, int(*)(FILE*)> file(fopen(fName.c_str(), "ab"), fclose);
+	if (!file)	Err(Err::F_OPEN, fName.c_str()).Throw();
+	CopyBlocks(Chrom::UnID, file.get(), fName);
+}
+
+/************************ class RecInFile: end ************************/
 
 /************************ class OutFile ************************/
 
@@ -692,7 +1367,7 @@ float Output::OutFile::StrandErrProb;	// the probability of strand error
 // Creates and initializes new instance for writing.
 //	@fName: common file name without extention
 //	@cSizes: chrom sizes
-Output::OutFile::OutFile(const string& fName, const ChromSizesExt& cSizes)
+Output::OutFile::OutFile(const string& fName, const ChromSizesExt& cSizes, BYTE rep, bool control)
 {
 	if (HasFormat(eFormat::FG))
 		if (Seq::IsPE())
@@ -703,8 +1378,15 @@ Output::OutFile::OutFile(const string& fName, const ChromSizesExt& cSizes)
 	if (HasFormat(eFormat::BED))	_bedFile = new BedROutFile(fName, _rName);
 	if (HasFormat(eFormat::SAM))	_samFile = new SamOutFile(fName, _rName, cSizes);
 	if (HasFormat(eFormat::BGR))	_bgFile = new BedGrOutFiles(fName, cSizes);
-	if (HasFormat(eFormat::FDENS))	_coverFile[0] = new Wig0OutFile(fName, false, cSizes);
-	if (HasFormat(eFormat::RDENS))	_coverFile[1] = new Wig0OutFile(fName, true, cSizes);
+	for (BYTE i = 0; i < ND; i++)
+		if (HasContigFormat(eFormat::FDENS, i))
+			if (CoverOutFile::BigWig)
+				_coverFile[i] = new BigWigOutFile(fName + (i ? ".rdens" : ".fdens"), true,
+					i ? Mutex::eType::WR_RDENS : Mutex::eType::WR_FDENS, cSizes);
+			else
+				_coverFile[i] = new Wig0OutFile(fName, i, cSizes);
+	if (Sink)	_recFile = new RecOutFile(Sink, rep, control);
+	else if (HasFormat(eFormat::REC))	_recFile = new RecOutFile(fName);
 }
 
 // Clone constructor for multithreading
@@ -721,6 +1403,7 @@ Output::OutFile::OutFile(const OutFile& file) : _primer(false)
 	_bgFile = file._bgFile;						// primer files are common for the all clones
 	_coverFile[0] = file._coverFile[0];			// primer file is common for the all clones
 	_coverFile[1] = file._coverFile[1];			// primer file is common for the all clones
+	if (file._recFile)	_recFile = new RecOutFile(*file._recFile);
 }
 
 Output::OutFile::~OutFile()
@@ -729,6 +1412,7 @@ Output::OutFile::~OutFile()
 	delete _fqFile2;
 	delete _bedFile;
 	delete _samFile;
+	delete _recFile;
 	if (_primer) {
 		delete _bgFile;
 		for (const auto& f : _coverFile)
@@ -743,9 +1427,10 @@ void Output::OutFile::BeginWriteChrom(const RefSeq& seq)
 	_rName.SetChrom(Chrom::Mark(seq.ID()));
 	if (_bedFile)	_bedFile->SetChrom(seq.ID());	// set chrom's name for writing.
 	if (_samFile)	_samFile->SetChrom(seq.ID());	// set chrom's name for writing.
-	if (_bgFile)	_bgFile->SetChrom(seq.ID());	// set chrom's coverage as current
-	for(auto& cf : _coverFile)
-		if (cf)		cf->OpenChromData(seq.ID());	// set chrom's density as current
+	if (_bgFile)	_bgFile->OpenChrom(seq.ID(), _bgCover);	// set chrom's coverage as current
+	for (BYTE i = 0; i < ND; i++)
+		if (_coverFile[i])	_densCover[i] = &_coverFile[i]->ChromData(seq.ID());	// set chrom's density as current
+	if (_recFile)	_recFile->SetChrom(seq.ID());
 }
 
 // Stop recording chrom
@@ -754,6 +1439,7 @@ void Output::OutFile::EndWriteChrom() const
 	if (_bgFile)	_bgFile->CloseChrom(_seq->ID());
 	for (const auto& f : _coverFile)
 		if(f)	f->CloseChromData(_seq->ID());
+	if (_recFile)	_recFile->EndChrom();
 }
 
 // Adds one SE Read
@@ -766,8 +1452,8 @@ void Output::OutFile::EndWriteChrom() const
 int Output::OutFile::AddReadSE(const Region& frag, readlen rLen, bool reverse)
 {
 	const chrlen rPos = reverse ? frag.End - rLen : frag.Start;	// Read's position
-	const Read read(_seq->Seq(rPos), rPos, rLen);
-	int ret = read.CheckNLimit();
+	const Read read(ReadSeq(rPos), rPos, rLen);
+	int ret = CheckNLimit(read);
 	if(ret)		return ret;
 	/*
 	if(RandomReverse && g==Gr::FG && _rng.Sample(OutFile::StrandErrProb) ) {
@@ -785,9 +1471,10 @@ int Output::OutFile::AddReadSE(const Region& frag, readlen rLen, bool reverse)
 	}
 	*/
 
-	if (_bgFile)		_bgFile->AddFrag(frag, reverse);		// coverage
-	if (_coverFile[0])	_coverFile[0]->AddFrag(frag);			// frag density
-	if (_coverFile[1])	_coverFile[1]->AddRead(read, reverse);	// read density
+	if (_recFile)		_recFile->AddRead(frag, rLen, reverse);	// binary record
+	if (_bgFile)		_bgCover[reverse]->AddRegion(frag);		// coverage
+	if (_coverFile[0])	_densCover[0]->AddFrag(frag);			// frag density
+	if (_coverFile[1])	_densCover[1]->AddRead(read, reverse);	// read density
 	if (InclReadName()) {
 		_rName.AddInfo(frag);
 		if (_fqFile1)	_fqFile1->AddRead(read, reverse);
@@ -807,18 +1494,19 @@ int Output::OutFile::AddReadSE(const Region& frag, readlen rLen, bool reverse)
 //			-1: N limit is exceeded
 int Output::OutFile::AddReadPE(const Region& frag, readlen rLen, bool reverse)
 {
-	const Read read1(_seq->Seq(frag.Start), frag.Start, rLen);
-	int ret = read1.CheckNLimit();
+	const Read read1(ReadSeq(frag.Start), frag.Start, rLen);
+	int ret = CheckNLimit(read1);
 	if (ret)	return ret;
 	chrlen pos2 = frag.End - rLen;
-	const Read read2(_seq->Seq(pos2), pos2, rLen);
-	ret = read2.CheckNLimit();
+	const Read read2(ReadSeq(pos2), pos2, rLen);
+	ret = CheckNLimit(read2);
 	if (ret)	return ret;
 
-	if (_bgFile)		_bgFile->AddFrag(frag, reverse);		// coverage
-	if (_coverFile[0])	_coverFile[0]->AddFrag(frag);			// frag density
-	if (_coverFile[1])	_coverFile[1]->AddRead(read1, reverse),	// read density
-						_coverFile[1]->AddRead(read2, reverse);
+	if (_recFile)		_recFile->AddRead(frag, rLen, reverse);	// binary record
+	if (_bgFile)		_bgCover[reverse]->AddRegion(frag);		// coverage
+	if (_coverFile[0])	_densCover[0]->AddFrag(frag);			// frag density
+	if (_coverFile[1])	_densCover[1]->AddRead(read1, reverse),	// read density
+						_densCover[1]->AddRead(read2, reverse);
 	if (InclReadName()) {
 		_rName.AddInfo(frag);
 		if (_fqFile1)	_fqFile1->AddRead(read1, false),
@@ -866,6 +1554,44 @@ void Output::OutFile::PrintFormat(const char* signOut, const char* predicate) co
 		}
 		cout << LF;
 	}
+	if (HasFormat(eFormat::REC) || Sink)
+		cout << signOut << predicate << "records: " << (Sink ? "in memory" : _recFile->FileName()) << LF;
+}
+
+// Returns estimated size of the chrom's coverage accumulated while generating, in bytes
+//	@len: chrom's length
+size_t Output::OutFile::ChromMemSize(chrlen len) const
+{
+	// the whole chrom is covered by background: all coverage blocks are allocated
+	BYTE cnt = _bgFile ? (BedGrOutFiles::IsStrands ? 3 : 1) : 0;
+
+	for (const auto f : _coverFile)
+		if (f)	cnt++;
+	return size_t(cnt) * len * sizeof(codelta);
+}
+
+// Returns size of the clone's I/O buffers in bytes
+size_t Output::OutFile::BuffMemSize() const
+{
+	const BYTE cnt = bool(_fqFile1) + bool(_fqFile2) + bool(_bedFile) + bool(_samFile);
+
+	return cnt * TxtFile::CloneBuffLen + (_recFile ? RecOutFile::BuffSize() : 0);
+}
+
+// Preallocates the Read files by the estimated number of Reads
+//	@rCnt: estimated number of Reads
+void Output::OutFile::Reserve(ULLONG rCnt) const
+{
+	const LLONG rLen = DistrParams::IsRVL() ? LLONG(DistrParams::rdMean) : Read::FixedLen;
+	const LLONG nLen = ReadName::EstLength(rCnt);
+	const LLONG mCnt = rCnt >> int(Seq::IsPE());		// number of Reads in each mate file
+
+	// record lengths: delimiters and small fields are estimated in excess,
+	// since the surplus is released on closing
+	if (_bedFile)	_bedFile->Reserve(rCnt * (Chrom::MaxAbbrNameLength + 2 * CHRLEN_CAPAC + nLen + 12));
+	if (_fqFile1)	_fqFile1->Reserve(mCnt * (nLen + 2 * rLen + 16));
+	if (_fqFile2)	_fqFile2->Reserve(mCnt * (nLen + 2 * rLen + 16));
+	if (_samFile)	_samFile->Reserve(rCnt * (nLen + 2 * rLen + Chrom::MaxAbbrNameLength + 3 * CHRLEN_CAPAC + 24));
 }
 
 /************************ class OutFile: end ************************/
@@ -878,14 +1604,8 @@ const char* Output::DistrFiles::entityAdjust[] = { " size",	" length" };
 Output::DistrFiles::DistrFiles(const string& fName, bool isFragDist, bool isReadDist)
 	: _fName(fName)
 {
-	if (isFragDist) {
-		_dist[0] = new LenFreq();
-		_fAddFrag = [&](fraglen flen) {_dist[0]->AddLen(flen); };
-	}
-	if (isReadDist) {
-		_dist[1] = new LenFreq();
-		_fAddRead = [&](readlen rlen) {_dist[1]->AddLen(rlen); };
-	}
+	if (isFragDist)	_dist[0] = new LenFreq();
+	if (isReadDist)	_dist[1] = new LenFreq();
 }
 
 // Writes distributions to files and delete them
@@ -917,11 +1637,13 @@ Output::DistrFiles::~DistrFiles()
 		}
 }
 
-// Adds frag/read length to statistics
-void Output::DistrFiles::AddFrag(fraglen flen, readlen rlen)
+// Merges thread's histograms into distributions
+//	@hists: merged histograms
+void Output::DistrFiles::Merge(const Hists& hists)
 {
-	_fAddFrag(flen);		// fragments
-	_fAddRead(rlen);		// reads
+	lock_guard<mutex> lock(_merge);
+	for (BYTE i = 0; i < ND; i++)
+		if (hists._hist[i])	_dist[i]->Add(*hists._hist[i]);
 }
 
 // Prints output file formats and sequencing mode
@@ -947,8 +1669,11 @@ void Output::DistrFiles::PrintFormat(const char* signOut, const char* predicate)
 
 //bool	Output::RandomReverse = true;	// true if Read should be reversed randomly
 string	Output::MapQual;				// the mapping quality
+ReadSink*	Output::Sink = NULL;		// receiver of Read records instead of the REC file, or NULL
+vector<BYTE> Output::Tiers;				// nested depth tiers in percent, in ascending order
 int		Output::Format;					// output formats as int
 bool	Output::inclReadName;			// true if Read name is included into output data
+bool	Output::seqFree;				// true if no output format needs nucleotides
 const char* Output::entityTitles[] = { "fragment", Read::title };
 
 // Initializes static members
@@ -957,19 +1682,37 @@ const char* Output::entityTitles[] = { "fragment", Read::title };
 //	@bgStrand: true if bedGraphs with different strands should be generated
 //	@strandErrProb: the probability of strand error
 //	@zipped: true if output files should be zipped
-void Output::Init(int fFormat, BYTE mapQual, bool bgStrand, float strandErrProb, bool zipped)
+//	@densBin: density bin length
+//	@densFixed: true if density should be written in fixedStep format
+//	@wigMem: memory limit for WIG data waiting for writing, in Mb, or 0 if unlimited
+//	@bigWig: true if coverage and density should be written in bigWig format
+void Output::Init(int fFormat, BYTE mapQual, bool bgStrand, float strandErrProb, bool zipped,
+	chrlen densBin, bool densFixed, UINT wigMem, bool bigWig)
 {
-	Format = int(eFormat(fFormat));
-	inclReadName = HasFormat(eFormat::FG, eFormat::BED, eFormat::SAM);
+	SetFormat(fFormat);
+	RecOutFile::Resume = false;
 	MapQual = to_string(mapQual);
 	BedGrOutFiles::IsStrands = !Seq::IsPE() && bgStrand;
 	TxtOutFile::Zipped = zipped;
+	DensCover::BinLen = densBin;
+	Wig0OutFile::FixedStep = densFixed;
+	CoverOutFile::MemLimit = size_t(wigMem) << 20;
+	CoverOutFile::BigWig = bigWig;
 	OutFile::Init(strandErrProb);
 	ReadName::Init();
 	FqOutFile::Init();
 	SamOutFile::Init();
 }
 
+// Sets output formats, keeping other initialized parameters
+//	@fFormat: types of output files
+void Output::SetFormat(int fFormat)
+{
+	Format = int(eFormat(fFormat));
+	inclReadName = HasFormat(eFormat::FG, eFormat::BED, eFormat::SAM);
+	seqFree = !HasFormat(eFormat::FG, eFormat::SAM) && !(HasFormat(eFormat::BED) && Read::IsNLimit());
+}
+
 // Prints item title ("reads/fragments") according to output formats
 void Output::PrintItemTitle()
 {
@@ -991,13 +1734,21 @@ void Output::PrintItemCount(ULLONG fCnt)
 //	@cmLine: command line to add as a comment in the first file line
 //	@cSizes: chrom sizes, or NULL
 Output::Output(
-	const string& fName, bool control, const string& cmLine, const ChromSizesExt& cSizes)
+	const string& fName, bool control, const string& cmLine, const ChromSizesExt& cSizes, BYTE rep)
 	: _dists(new DistrFiles(fName, HasFormat(eFormat::FDIST), HasFormat(eFormat::RDIST))),
 	_gMode(BYTE(GM::eMode::Test))
 {
 	DataOutFile::CommLine = &cmLine;
-	_oFiles[0].reset(new OutFile(fName, cSizes));
-	if (control)	_oFiles[1].reset(new OutFile(fName + "_input", cSizes));
+	_oFiles[0].reset(new OutFile(fName, cSizes, rep, false));
+	if (control)	_oFiles[1].reset(new OutFile(fName + "_input", cSizes, rep, true));
+	_tiers.reserve(Tiers.size());
+	for (BYTE pct : Tiers) {
+		const string tName = fName + "_d" + to_string(pct);
+
+		_tiers.emplace_back(ULLONG(pct) * (1ULL << 32) / 100);
+		_tiers.back().Files[0].reset(new OutFile(tName, cSizes));
+		if (control)	_tiers.back().Files[1].reset(new OutFile(tName + "_input", cSizes));
+	}
 }
 
 // Clone constructor for multithreading.
@@ -1006,20 +1757,87 @@ Output::Output(const Output& file) : _dists(file._dists), _gMode(file._gMode)
 {
 	_oFiles[0].reset(new OutFile(*file._oFiles[0]));
 	if (file._oFiles[1])	_oFiles[1].reset(new OutFile(*file._oFiles[1]));
+	_tiers.reserve(file._tiers.size());
+	for (const Tier& t : file._tiers) {
+		_tiers.emplace_back(t.Thresh);
+		for (BYTE i = 0; i < 2; i++)
+			if (t.Files[i])	_tiers.back().Files[i].reset(new OutFile(*t.Files[i]));
+	}
 }
 	
 // Starts recording chrom
-void Output::BeginWriteChrom(const RefSeq& seq)
+//	@seq: chrom's sequence
+//	@all: if true then starts both Test and Control files, otherwise the files of the current mode only
+void Output::BeginWriteChrom(const RefSeq& seq, bool all)
+{
+	for (BYTE i = 0; i < 2; i++)
+		if (all || i == _gMode) {
+			if (_oFiles[i])	_oFiles[i]->BeginWriteChrom(seq);
+			for (const Tier& t : _tiers)
+				if (t.Files[i])	t.Files[i]->BeginWriteChrom(seq);
+		}
+	// Control Reads are numbered within each chrom,
+	// so their names don't depend on the threads generating the separate Control tasks
+	if ((all || _gMode == BYTE(GM::eMode::Control)) && _oFiles[1]) {
+		_oFiles[1]->ResetReadCounter();
+		for (const Tier& t : _tiers)
+			if (t.Files[1])	t.Files[1]->ResetReadCounter();
+	}
+	_cID = seq.ID();
+	_rInd = 0;
+	// chrom's own stream, separate for Control:
+	// output doesn't depend on the chroms distribution, nor on the Test and Control one
+	_rng.Reset(ULONG(_gMode) << 16 | _cID);
+}
+
+// Returns estimated size of the chrom's coverage accumulated while generating, in bytes
+//	@len: chrom's length
+size_t Output::ChromMemSize(chrlen len) const
+{
+	size_t size = _oFiles[0]->ChromMemSize(len);
+
+	if (_oFiles[1])	size += _oFiles[1]->ChromMemSize(len);
+	for (const Tier& t : _tiers)
+		for (const auto& f : t.Files)
+			if (f)	size += f->ChromMemSize(len);
+	return size;
+}
+
+// Returns size of the clone's I/O buffers in bytes
+size_t Output::BuffMemSize() const
+{
+	size_t size = _oFiles[0]->BuffMemSize();
+
+	if (_oFiles[1])	size += _oFiles[1]->BuffMemSize();
+	for (const Tier& t : _tiers)
+		for (const auto& f : t.Files)
+			if (f)	size += f->BuffMemSize();
+	return size;
+}
+
+// Preallocates the Read files by the estimated numbers of Reads
+//	@tCnt: estimated number of Test Reads
+//	@cCnt: estimated number of Control Reads
+void Output::Reserve(ULLONG tCnt, ULLONG cCnt) const
 {
-	_oFiles[0]->BeginWriteChrom(seq);
-	if(_oFiles[1])	_oFiles[1]->BeginWriteChrom(seq);
+	_oFiles[0]->Reserve(tCnt);
+	if (_oFiles[1])	_oFiles[1]->Reserve(cCnt);
+	for (const Tier& t : _tiers) {		// tier keeps the share of Reads by its threshold
+		t.Files[0]->Reserve(tCnt * t.Thresh >> 32);
+		if (t.Files[1])	t.Files[1]->Reserve(cCnt * t.Thresh >> 32);
+	}
 }
 
 // Stops recording chrom
-void Output::EndWriteChrom()
+//	@all: if true then stops both Test and Control files, otherwise the files of the current mode only
+void Output::EndWriteChrom(bool all)
 {
-	_oFiles[0]->EndWriteChrom();
-	if(_oFiles[1])	_oFiles[1]->EndWriteChrom();
+	for (BYTE i = 0; i < 2; i++)
+		if (all || i == _gMode) {
+			if (_oFiles[i])	_oFiles[i]->EndWriteChrom();
+			for (const Tier& t : _tiers)
+				if (t.Files[i])	t.Files[i]->EndWriteChrom();
+		}
 }
 
 // Adds read(s) to output file
@@ -1033,21 +1851,89 @@ void Output::EndWriteChrom()
 int Output::AddRead(chrlen pos, fraglen flen, /*Gr::eType g,*/ bool reverse)
 {
 	/*****
-	 1) Fill distribution files doesn't need by the trial pass,
-	 Acceptable, because
-		a) trial pass is performed just once, and it's very unlikely that the format DIST
-		will be set on the first pass
-		b) even so, it almost doesn't matter for the distribution statistics
-	 2) Generation Read variable length generation is not needed if one format BG is set.
+	 Generation Read variable length generation is not needed if one format BG is set.
 	 Acceptable, because it's very unlikely that the only format BG and RVL are set at the same time
 	*****/
+	if (OutFile::IsTrial())	return 0;	// trial pass records nothing, including the distributions
 	readlen rlen = Read::FixedLen;
 	if (DistrParams::IsRVL()) {
 		rlen = readlen(_rng.Normal() * DistrParams::rdSigma + DistrParams::rdMean);
 		if (rlen > Read::VarMaxLen || rlen > flen)	rlen = flen;
 	}
-	_dists->AddFrag(flen, rlen);
-	return _oFiles[_gMode]->AddRead(Region(pos, pos + flen), rlen, reverse);
+	_hists.AddFrag(flen, rlen);
+	const Region frag(pos, pos + flen);
+	const int res = _oFiles[_gMode]->AddRead(frag, rlen, reverse);
+	if (!res && _tiers.size()) {
+		// the Read falls into the tiers from the deepest one down to the one whose threshold exceeds its hash
+		const ULLONG hash = KeyHash(_cID, _rInd++);
+		for (auto t = _tiers.rbegin(); t != _tiers.rend() && hash < t->Thresh; t++)
+			t->Files[_gMode]->AddRead(frag, rlen, reverse);
+	}
+	return res;
+}
+
+// Renders binary Read records into the set formats, treating chroms concurrently
+//	@file: records file
+//	@cSizes: chrom sizes with treated chroms which have records
+//	@thrCnt: number of threads
+//	@ctrlFile: control records file rendered into control output, or NULL
+//	return: number of rendered records
+ULLONG Output::Render(const RecInFile& file, const ChromSizesExt& cSizes, thrid thrCnt,
+	const RecInFile* ctrlFile)
+{
+	vector<chrid> cIDs;
+	for (const auto& cs : cSizes)
+		if (cs.second.Treated)	cIDs.push_back(cs.first);
+	if (!cIDs.size())	return 0;
+
+	OutFile::SetSeqMode(false);
+	atomic<size_t> next(0);		// index of the next chrom to render
+	atomic<ULLONG> rCnt(0);		// number of rendered records
+	string	errMsg;				// the first exception message
+	mutex	errLock;
+	auto stop = [&](const char* msg) {
+		lock_guard<mutex> lock(errLock);
+		if (!errMsg.length())	errMsg = msg;
+		next = cIDs.size();		// stop all threads
+	};
+	auto render = [&](Output& output) {
+		SeqArena arena;			// thread's reusable sequence buffer
+		try {
+			for (size_t i; (i = next++) < cIDs.size();) {
+				const RefSeq seq(cIDs[i], cSizes, !IsSeqFree(), &arena);
+				ULLONG cnt = 0;
+				auto addRecs = [&](const RecInFile& f, OutFile& oFile) {
+					f.DoWithRecs(cIDs[i], [&](const RecOutFile::Rec& rec) {
+						output._hists.AddFrag(rec.Len, rec.RLen);
+						if (!oFile.AddRead(Region(rec.Start, rec.Start + rec.Len), rec.RLen, rec.Reverse))
+							cnt++;
+					});
+				};
+
+				output.BeginWriteChrom(seq);
+				addRecs(file, *output._oFiles[0]);
+				if (ctrlFile)	addRecs(*ctrlFile, *output._oFiles[1]);
+				output.EndWriteChrom();
+				rCnt += cnt;
+			}
+		}
+		catch (const Err& e)		{ stop(e.what()); }
+		catch (const exception& e)	{ stop(e.what()); }
+	};
+
+	if (thrCnt > cIDs.size())	thrCnt = thrid(cIDs.size());
+	vector<unique_ptr<Output>> clones;
+	vector<thread> threads;
+	threads.reserve(thrCnt - 1);
+	for (thrid i = 1; i < thrCnt; i++) {
+		clones.emplace_back(new Output(*this));
+		threads.emplace_back(render, ref(*clones.back()));
+	}
+	render(*this);				// main thread works too
+	for (thread& t : threads)	t.join();
+	clones.clear();				// merge clones histograms
+	if (errMsg.length())	Err(errMsg).Throw();
+	return rCnt;
 }
 
 // Prints output file formats and sequencing mode
@@ -1059,6 +1945,11 @@ void Output::PrintFormat(const char* signOut) const
 	_oFiles[0]->PrintFormat(signOut, output);
 	_dists->PrintFormat(signOut, output);
 	if(_oFiles[1])	cout << signOut << output << "control supplied\n";
+	if (Tiers.size()) {
+		cout << signOut << output << "depth tiers" << SepCl;
+		for (BYTE pct : Tiers)	cout << int(pct) << "%, ";
+		cout << "files are suffixed by '_d<N>'\n";
+	}
 }
 
 // Prints Read quality settins
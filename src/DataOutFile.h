@@ -9,6 +9,8 @@ Provides output data text files functionality
 #pragma once
 #include <fstream>		// Frag freguency ofstream
 #include <memory>		// smart ptr
+#include <atomic>
+#include <deque>
 #include "Data.h"
 #include "RandomGen.h"
 
@@ -98,6 +100,10 @@ public:
 	// Returns maximum length of Read's name
 	inline static BYTE MaxLength() { return len; }
 
+	// Returns estimated length of Read's name
+	//	@rCnt: number of Reads
+	inline static BYTE EstLength(ULLONG rCnt) { return BYTE(len - 20 + to_string(rCnt).length()); }
+
 	// Initializes instance by constant part of Read name
 	//	@rCnt: external Read counter
 	ReadName(ULLONG& rCnt);
@@ -404,10 +410,12 @@ public:
 //	extended by methods inserting single length elements (to form the 'density')
 class DensCover : public AccumCover
 {
-	// Adds item start position to statistics
-	inline void AddPos(chrlen pos) { (*this)[pos /*+ pos%2*/]++; }
+	// Adds item start position to statistics; the array keeps plain frequencies of bins here
+	inline void AddPos(chrlen pos) { AddDelta(pos / BinLen, 1); }
 
 public:
+	static chrlen BinLen;	// density bin length
+
 	// Adds Read to accumulate the density
 	//	@tag: added Read
 	//	@reverse: if true then add complemented read
@@ -418,16 +426,59 @@ public:
 	inline void AddFrag(const Region& frag) { AddPos(frag.Centre()); }
 };
 
-// 'WigOutFile' is a base class for BedGrOutFile (BedGraph format) and Wig0OutFile (variableStep format)
-class WigOutFile : public Chroms<DensCover>, public TxtOutFile
+// 'CoverOutFile' is a base class for coverage and density output files.
+// Keeps chroms data filled by different threads and records it in chrom sorted order.
+class CoverOutFile : public Chroms<DensCover>
 {
-	static const string WigFormats[];
+	static atomic<size_t> HeldSize;	// total size of closed data waiting for writing in all files
+
+	const string	_tmpName;	// common part of temporary files name
+	Mutex::eType	_mType;		// mutex type used only in CloseChromData; file mutex type is defined by file type
+	Iter	_unsaved;			// first chrom's data not saved yet; guarded by _mType
+
+	// Records chrom's data
+	virtual void WriteChromData(chrid cID) = 0;
+
+	// Prepares chrom's data for recording; called by the closing thread before the file is locked
+	virtual void PrepareChromData(chrid cID) {}
+
+protected:
+	// Creates new instance
+	//	@tmpName: common part of temporary files name
+	//	@mtype: mutex locker type
+	//	@cSizes: chrom sizes
+	CoverOutFile(const string& tmpName, Mutex::eType mtype, const ChromSizesExt& cSizes);
+
+	// Creates new strand-separated instance
+	//	@strandInd: strand index: 0 - positive, 1 - negative
+	//	@tmpName: common part of temporary files name
+	//	@file: united strands file
+	CoverOutFile(int strandInd, const string& tmpName, const CoverOutFile& file);
+
+public:
+	// maximum size of closed data waiting for writing, in bytes, or 0 if unlimited;
+	// data exceeding the limit is kept in temporary files
+	static size_t MemLimit;
+	static bool BigWig;		// true if coverage and density are written in bigWig format
 
-	Mutex::eType _mType;	// mutex type used only in CloseChromData; file mutex type is defined by file type
-	DensCover* _cover;		// current treated chrom's data
+	virtual ~CoverOutFile() {}
+
+	// Returns output file name
+	virtual const string& FileName() const = 0;
+
+	// Returns data container for given chrom.
+	// Each chrom is filled by a single thread, so the container is used without locking.
+	inline DensCover& ChromData(chrid cID) { return At(cID).Data; }
+
+	// Close data container for given chrom
+	//	@cID: chrom ID
+	void CloseChromData(chrid cID);
+};
 
-	// Fill IO buffer by chrom's data
-	virtual void WriteChromData(chrid cID) {}
+// 'WigOutFile' is a base class for BedGrOutFile (BedGraph format) and Wig0OutFile (variableStep format)
+class WigOutFile : public CoverOutFile, public TxtOutFile
+{
+	static const string WigFormats[];
 
 	// Initializes line write buffer, adds command and definition lines
 	//	@ftype: BGRAPH or WIG_VAR
@@ -450,30 +501,16 @@ public:
 	//	@fName: file name without extention
 	//	@descr: brief file description in declaration line
 	//	@strand: string denoted strand, or empty string
-	WigOutFile(int strandInd, const string& fName, const char* descr, const char* strand) :
-		_mType(Mutex::eType(int(Mutex::eType::WR_BG) + strandInd)),
+	//	@file: united strands file
+	WigOutFile(int strandInd, const string& fName, const char* descr, const char* strand, const WigOutFile& file) :
+		CoverOutFile(strandInd, fName, file),
 		TxtOutFile(FT::eType::BGRAPH, fName, TAB)
-	{ Init(FT::eType::BGRAPH, fName, descr, strand); }
-
-	// Creates and returns data container for given chrom
-	inline void OpenChromData(chrid cID) { _cover = &At(cID).Data; }
-
-	// Close data container for given chrom
-	//	@cID: chrom ID
-	void CloseChromData(chrid cID);
-
-	// Adds fragment to coverage
-	//	@frag: added fragment
-	inline void AddFragCov(const Region& frag) { _cover->AddRegion(frag); }
-
-	// Adds fragment to accumulate the density
-	//	@frag: added frag
-	inline void AddFrag(const Region& frag) { _cover->AddFrag(frag); }
+	{ 
+		Init(FT::eType::BGRAPH, fName, descr, strand);
+	}
 
-	// Adds Read to accumulate the density
-	//	@tag: added Read
-	//	@reverse: if true then add complemented read
-	inline void AddRead(const Read& tag, bool reverse) { _cover->AddRead(tag, reverse); }
+	// Returns output file name
+	const string& FileName() const { return TxtOutFile::FileName(); }
 };
 
 // 'BedGrOutFiles' implements methods for writing 1 common and 2 strands-based bedGraph files
@@ -501,17 +538,16 @@ class BedGrOutFiles
 		//	@strand: string denoted strand, or empty string
 		//	@file: united strands file
 		BedGrOutFile(int strandInd, const string& fName, const BedGrOutFile& file)
-			: WigOutFile(strandInd, fName, DeclDescr, StrandTitles[strandInd])
-		{ Assign(file); }
+			: WigOutFile(strandInd, fName, DeclDescr, StrandTitles[strandInd], file) {}
 	};
 
 	static const BYTE Count = 3;	// count of BedGraph files
 
 	// data: [0] - pos strend, [1] - neg strand, [2] - total
-	BedGrOutFile* _files[Count]{ nullptr,nullptr,nullptr };
+	CoverOutFile* _files[Count]{ nullptr,nullptr,nullptr };
 
 	// Applies function fn to each of the item in _files
-	void DoForFiles(function<void(BedGrOutFile*)> fn);
+	void DoForFiles(function<void(CoverOutFile*)> fn);
 
 public:
 	static bool IsStrands;			// true if wigs with different strands should be generated
@@ -521,37 +557,35 @@ public:
 	//	@cSizes: chrom sizes
 	BedGrOutFiles(const string& fName, const ChromSizesExt& cSizes);
 
-	~BedGrOutFiles() { DoForFiles([](BedGrOutFile* f) { delete f; }); }
+	~BedGrOutFiles() { DoForFiles([](CoverOutFile* f) { delete f; }); }
 
 	// Starts accumalating coverage for given chrom
 	//	@cID: chrom
-	void SetChrom(chrid cID) { 
-		// by turn; don't need critical section
-		DoForFiles([&cID](BedGrOutFile* f) { f->OpenChromData(cID); }); 
-	}
+	//	@covers: coverages to be filled by fragments: [0] - pos strand, [1] - neg strand;
+	//	both are the total coverage if strands are not set
+	void OpenChrom(chrid cID, DensCover* covers[2]);
 
 	// Stops accumalating coverage for given chrom
-	void CloseChrom(chrid cID) { 
-		DoForFiles([&cID](BedGrOutFile* f) { f->CloseChromData(cID); }); 
-	}
-
-	// Adds SE fragment to total coverage, and strand coverage if set
-	//	@frag: added fragment
-	//	@reverse: true if read is reversed (neg strand)
-	void AddFrag(const Region& frag, bool reverse);
+	void CloseChrom(chrid cID);
 
 	// Prints output file names separated by comma
 	//	@signOut: output marker
 	void PrintNames() const;
 };
 
-// 'Wig0OutFile' implements methods for writing reads coverage in wiggle_0 (variable step) file
+// 'Wig0OutFile' implements methods for writing reads coverage in wiggle_0 (variable or fixed step) file
 class Wig0OutFile : public WigOutFile
 {
+	// maximum number of empty bins written inside one fixedStep section;
+	// a longer gap opens a new section, which is shorter than the gap
+	static const chrlen MaxZeroRun = 16;
+
 	// Fill IO buffer by chrom data
 	void WriteChromData(chrid cID);
 
 public:
+	static bool FixedStep;	// true if density is written in fixedStep format
+
 	// Creates new instance for writing and initializes line write buffer.
 	//	@fName: file name without extention
 	//	@cSizes: chrom sizes
@@ -560,11 +594,359 @@ public:
 		FT::eType::WIG_VAR,
 		fName + (rdens ? ".rdens" : ".fdens"),
 		rdens ? "read density" : "frag density",
-		Mutex::eType::WR_RDENS,
+		rdens ? Mutex::eType::WR_RDENS : Mutex::eType::WR_FDENS,
 		cSizes
 	) {}
 };
 
+// 'BigWigOutFile' implements methods for writing coverage or density in bigWig format.
+// Data sections are built and compressed by the thread completing the chrom outside the file lock,
+// and recorded in chrom order; zoom levels are collected in the same pass;
+// indexes and header are recorded on closing.
+class BigWigOutFile : public CoverOutFile
+{
+	static const UINT	Magic = 0x888FFC26;		// bigWig signature
+	static const UINT	BlockSize = 256;		// maximum number of children per index node
+	static const UINT	ItemsPerSlot = 1024;	// maximum number of items per section
+	static const BYTE	ZoomCount = 10;			// maximum number of zoom levels
+	static const chrlen	ZoomBase = 1024;		// reduction of the first zoom level; each next one is 4 times more
+	static const BYTE	HeaderSize = 64;
+	static const BYTE	ZoomHeaderSize = 24;
+	static const BYTE	SummarySize = 40;
+
+	// region covered by section or index node
+	struct Bounds {
+		UINT	StartIx, Start, EndIx, End;	// chrom index and position of the start and of the end
+		ULLONG	Offset, Size;				// data offset and size in file
+	};
+
+	// zoom summary record as it is stored in file
+	struct ZoomRec {
+		UINT	ChromIx, Start, End, ValidCnt;
+		float	Min, Max, Sum, SumSquares;
+	};
+
+	// zoom level data
+	struct Zoom {
+		chrlen	Reduction;			// reduction level (summary record length)
+		UINT	RecCnt = 0;			// number of summary records
+		ZoomRec	Rec;				// current summary record
+		bool	IsRec = false;		// true if current summary record is opened
+		string	Sect;				// current uncompressed section
+		Bounds	SectBnd;			// current section bounds
+		deque<string>	Blobs;		// compressed sections; deque keeps references valid
+		vector<Bounds>	Sects;		// sections bounds; offsets are defined on closing
+	};
+
+	// total summary
+	struct Summary {
+		ULLONG	BasesCovered = 0;
+		double	MinVal = 0, MaxVal = 0, SumData = 0, SumSquares = 0;
+
+		// Adds item
+		//	@len: item length
+		//	@val: item value
+		void Add(chrlen len, float val);
+
+		// Adds another summary
+		void Add(const Summary& s);
+	};
+
+	// chrom's data prepared for recording
+	struct Chunk {
+		vector<string>	Data;		// compressed full data sections
+		vector<Bounds>	Bnds;		// full data sections bounds; offsets are defined on recording
+		Zoom	Zooms[ZoomCount];	// chrom's zoom levels
+		Summary	Summ;				// chrom's summary
+		UINT	MaxRawSize = 0;		// maximum uncompressed section size
+	};
+
+	FILE*	_file = nullptr;
+	const string	_fName;			// file name
+	const bool		_dens;			// true if density is recorded, otherwise coverage
+	ULLONG	_offset = 0;			// current file offset
+	ULLONG	_dataOffset;			// offset of full data
+	UINT	_chromIx = 0;			// index of the next recorded chrom
+	UINT	_maxRawSize = 0;		// maximum uncompressed section size
+	vector<chrlen>	_cLens;			// chrom lengths in recording order
+	vector<UINT>	_chromIxs;		// chrom indexes by chrom ID
+	vector<Chunk>	_chunks;		// prepared chroms data in recording order; each one is filled by its closing thread
+	vector<Bounds>	_sects;			// full data sections bounds
+	Zoom	_zooms[ZoomCount];
+	Summary	_summ;					// total summary
+
+	// Writes block to file
+	//	@data: pointer to the block
+	//	@size: size of the block
+	void Write(const void* data, size_t size);
+
+	// Writes string to file
+	inline void Write(const string& s) { Write(s.data(), s.size()); }
+
+	// Writes R-tree index
+	//	@sects: indexed sections
+	void WriteIndex(const vector<Bounds>& sects);
+
+	// Compresses sections
+	//	@sects: sections to be compressed in place
+	//	@maxRawSize: maximum uncompressed section size to be updated
+	void Compress(vector<string*>& sects, UINT& maxRawSize);
+
+	// Completes current zoom summary record
+	//	@z: zoom level
+	//	@sects: completed sections to be filled
+	void CloseZoomRec(Zoom& z, vector<string*>& sects);
+
+	// Completes current zoom section
+	//	@z: zoom level
+	//	@sects: completed sections to be filled
+	void CloseZoomSect(Zoom& z, vector<string*>& sects);
+
+	// Adds item to the zoom level summary
+	//	@z: zoom level
+	//	@ix: chrom index
+	//	@start: item start
+	//	@end: item end
+	//	@val: item value
+	//	@sects: completed sections to be filled
+	void AddToZoom(Zoom& z, UINT ix, chrlen start, chrlen end, float val, vector<string*>& sects);
+
+	// Builds and compresses chrom's sections outside the file lock
+	void PrepareChromData(chrid cID);
+
+	// Records chrom's prepared data
+	void WriteChromData(chrid cID);
+
+	// Opens file, writes header placeholder and chrom tree; common part of the constructors
+	void Open();
+
+public:
+	// Creates new instance for writing
+	//	@fName: file name without extention
+	//	@dens: true if density is recorded, otherwise coverage
+	//	@mtype: mutex locker type
+	//	@cSizes: chrom sizes
+	BigWigOutFile(const string& fName, bool dens, Mutex::eType mtype, const ChromSizesExt& cSizes);
+
+	// Creates new strand-separated coverage instance for writing
+	//	@strandInd: strand index: 0 - positive, 1 - negative
+	//	@fName: file name without extention
+	//	@file: united strands file
+	BigWigOutFile(int strandInd, const string& fName, const BigWigOutFile& file);
+
+	// Writes indexes and header, closes file
+	~BigWigOutFile();
+
+	// Returns output file name
+	const string& FileName() const { return _fName; }
+};
+
+class ReadSink;
+
+// 'RecOutFile' implements methods for writing Reads in compact binary format.
+// Each clone buffers its records and writes them in blocks of one chrom,
+// so the file can be rendered later into any other format (option --render).
+// In the sink mode the blocks are passed to the ReadSink instead of the file.
+class RecOutFile
+{
+public:
+	static const UINT	Magic = 0x31434552;		// 'REC1' signature
+	static const char*	Ext;					// file extention
+
+	// file header
+	struct Header {
+		UINT	Magic;
+		readlen	RLen;		// fixed Read length
+		BYTE	PE;			// 1 if paired-end sequencing
+		BYTE	RVL;		// 1 if Read variable length
+	};
+
+	// block header
+	struct Block {
+		chrid	cID;		// chrom of records
+		uint16_t Reserved;
+		UINT	Count;		// number of records in block
+	};
+
+	// Read record
+	struct Rec {
+		chrlen	Start;		// fragment's start position
+		fraglen	Len;		// fragment's length
+		readlen	RLen;		// Read's length
+		BYTE	Reverse;	// 1 if Read is complemented
+		BYTE	Reserved;
+	};
+
+	// Returns size of the records buffer in bytes
+	inline static size_t BuffSize() { return BlockCapacity * sizeof(Rec); }
+
+private:
+	static const UINT BlockCapacity = 1 << 16;	// maximum number of records in block
+
+	FILE*	_file = NULL;		// file; common for the all clones
+	const string	_fName;		// file name
+	const bool		_primer;	// true if file is primer (not clone)
+	ReadSink*	_sink = NULL;	// records receiver in the sink mode, or NULL
+	BYTE	_rep = 0;			// replicate; used in the sink mode only
+	bool	_control = false;	// true if control records; used in the sink mode only
+	chrid	_cID = Chrom::UnID;	// current chrom
+	vector<Rec>	_recs;			// buffered records
+
+	// Writes buffered records as a block and flushes the file stream,
+	// so the completed chrom's records survive the process interruption
+	void Flush();
+
+public:
+	static bool	Resume;		// true if existing file should be continued instead of rewritten
+
+	// Leaves in existing file the blocks of the stated chroms only.
+	// Used to drop the records of uncompleted chroms before resuming.
+	//	@fName: file name without extention
+	//	@cIDs: sorted IDs of the kept chroms
+	static void Compact(const string& fName, const vector<chrid>& cIDs);
+
+	// Creates new instance for writing, or continues existing file in the Resume mode
+	//	@fName: file name without extention
+	RecOutFile(const string& fName);
+
+	// Creates new instance in the sink mode
+	//	@sink: records receiver
+	//	@rep: replicate
+	//	@control: true if control records are passed
+	RecOutFile(ReadSink* sink, BYTE rep, bool control)
+		: _primer(false), _sink(sink), _rep(rep), _control(control) { _recs.reserve(BlockCapacity); }
+
+	// Clone constructor for multithreading
+	//	@file: original instance
+	RecOutFile(const RecOutFile& file) : _file(file._file), _fName(file._fName), _primer(false),
+		_sink(file._sink), _rep(file._rep), _control(file._control) { _recs.reserve(BlockCapacity); }
+
+	~RecOutFile();
+
+	// Sets current chrom
+	inline void SetChrom(chrid cID) { _cID = cID; }
+
+	// Writes current chrom's buffered records
+	inline void EndChrom() { Flush(); }
+
+	// Adds Read record
+	//	@frag: Read's fragment
+	//	@rlen: Read's length
+	//	@reverse: if true then Read is complemented
+	inline void AddRead(const Region& frag, readlen rlen, bool reverse) {
+		_recs.push_back({ frag.Start, frag.Length(), rlen, BYTE(reverse), 0 });
+		if (_recs.size() == BlockCapacity)	Flush();
+	}
+
+	// Returns output file name
+	const string& FileName() const { return _fName; }
+};
+
+// 'ReadSink' receives Read records in memory instead of the REC file (see Output::Sink)
+class ReadSink
+{
+public:
+	// Read records of one chrom
+	struct Batch {
+		chrid	cID;		// chrom
+		BYTE	Rep;		// replicate, 0-based
+		bool	Control;	// true if records are control ('input') ones
+		size_t	Count;		// number of records
+		const RecOutFile::Rec* Recs;	// records; valid during the Push() call only
+	};
+
+	virtual ~ReadSink() {}
+
+	// Receives records. Called concurrently from the generating threads,
+	// each chrom's batches are passed by the same thread in recording order.
+	//	@batch: records
+	virtual void Push(const Batch& batch) = 0;
+};
+
+// 'RecInFile' implements methods for reading Reads in compact binary format.
+// Blocks are indexed by chrom on opening, so the chroms can be read concurrently.
+class RecInFile
+{
+	typedef RecOutFile::Rec	Rec;
+
+	// block position in file
+	struct Block {
+		ULLONG	Offset;		// offset of the first record
+		UINT	Count;		// number of records
+	};
+
+	const string	_fName;			// file name
+	RecOutFile::Header _header;
+	map<chrid, vector<Block>> _blocks;	// blocks of each chrom in recording order
+
+	// Reads block records
+	//	@file: opened file
+	//	@blk: read block
+	//	@recs: records to be filled
+	void Read(FILE* file, const Block& blk, vector<Rec>& recs) const;
+
+	// Writes chrom's blocks to the opened file
+	//	@cID: chrom's ID, or Chrom::UnID for all chroms
+	//	@oFile: opened output file
+	//	@oName: output file name
+	void CopyBlocks(chrid cID, FILE* oFile, const string& oName) const;
+
+public:
+	// Opens file, checks header and indexes blocks
+	//	@fName: file name
+	RecInFile(const string& fName);
+
+	// Returns true if paired-end Reads are recorded
+	inline bool IsPE() const { return _header.PE; }
+
+	// Returns fixed Read length
+	inline readlen ReadLen() const { return _header.RLen; }
+
+	// Returns true if Read variable length is recorded
+	inline bool IsRVL() const { return _header.RVL; }
+
+	// Writes chrom's records into new file
+	//	@cID: chrom's ID
+	//	@fName: new file name
+	void Extract(chrid cID, const string& fName) const;
+
+	// Appends all records to existing file with the same header
+	//	@fName: existing file name
+	void AppendTo(const string& fName) const;
+
+	// Returns IDs of chroms with records
+	vector<chrid> ChromIDs() const {
+		vector<chrid> cIDs;
+		for (const auto& b : _blocks)	cIDs.push_back(b.first);
+		return cIDs;
+	}
+
+	// Returns total number of records
+	ULLONG Count() const {
+		ULLONG cnt = 0;
+		for (const auto& b : _blocks)
+			for (const Block& blk : b.second)	cnt += blk.Count;
+		return cnt;
+	}
+
+	// Calls functor for each chrom's record in recording order
+	//	@cID: chrom's ID
+	//	@f: functor with const Rec& argument
+	template<typename F>
+	void DoWithRecs(chrid cID, F f) const
+	{
+		const auto it = _blocks.find(cID);
+		if (it == _blocks.end())	return;
+		unique_ptr<FILE, int(*)(FILE*)> file(fopen(_fName.c_str(), "rb"), fclose);
+		if (!file)	Err(Err::F_OPEN, _fName.c_str()).Throw();
+		vector<Rec> recs;
+		for (const Block& blk : it->second) {
+			Read(file.get(), blk, recs);
+			for (const Rec& rec : recs)	f(rec);
+		}
+	}
+};
+
 // 'Output' wraps test and control output files
 class Output
 {
@@ -580,12 +962,15 @@ public:
 		RDENS	= 0x20,
 		FDIST	= 0x40,
 		RDIST	= 0x80,
+		REC		= 0x100,	// binary Read records
 	};
 
 	static string	MapQual;	// the mapping quality
+	static ReadSink*	Sink;	// if set then Read records are passed to it instead of the REC file
 private:
 	static int	Format;					// output formats as int
 	static bool	inclReadName;			// true if Read name is included into output data
+	static bool	seqFree;				// true if no output format needs nucleotides
 	static const char* entityTitles[];	// entity titles for printing
 	static const BYTE ND = 2;			// number of distribution/density files
 
@@ -603,10 +988,20 @@ private:
 		BedROutFile	* _bedFile = nullptr;	// BED output
 		SamOutFile	* _samFile = nullptr;	// SAM output
 		BedGrOutFiles* _bgFile = nullptr;	// BedGraph output
-		Wig0OutFile* _coverFile[ND]{ nullptr,nullptr };	// frag density, read density output
+		CoverOutFile* _coverFile[ND]{ nullptr,nullptr };	// frag density, read density output
+		DensCover*	 _bgCover[2]{ nullptr,nullptr };	// current chrom's pos, neg strand coverage
+		DensCover*	 _densCover[ND]{ nullptr,nullptr };	// current chrom's frag, read density
+		RecOutFile	* _recFile = nullptr;	// binary records output
 		ReadName	 _rName{ _rCnt };		// Read's name; local for clone independence by setting different chroms
 		bool		 _primer = true;		// true if file is primer (not clone); only for BedGrOutFile
 
+		// Returns Read's sequence on position, or NULL in sequence-free mode
+		inline const char* ReadSeq(chrlen pos) const { return seqFree ? nullptr : _seq->Seq(pos); }
+
+		// Checks Read for number of 'N'; in sequence-free mode there is nothing to check
+		//	return:	1: NULL Read; 0: success; -1: N limit is exceeded
+		inline static int CheckNLimit(const Read& read) { return seqFree ? 0 : read.CheckNLimit(); }
+
 		// Adds one SE Read
 		//	@frag: added fragment
 		//	@rLen: Read's length
@@ -635,6 +1030,9 @@ private:
 		//	@sErrProb: the probability of strand error
 		inline static void Init(float sErrProb) { StrandErrProb = sErrProb; }
 
+		// Returns true in trial (empty) mode
+		inline static bool IsTrial() { return fAddRead == &Output::OutFile::AddReadEmpty; }
+
 		// Sets sequense mode.
 		//	@trial: if true, then set empty mode, otherwise current working mode
 		static void SetSeqMode(bool trial)	{ 
@@ -645,7 +1043,9 @@ private:
 		// Creates and initializes new instance for writing.
 		//	@fName: common file name without extention
 		//	@cSizes: chrom sizes
-		OutFile(const string& fName, const ChromSizesExt& cSizes);
+		//	@rep: replicate; used by the read sink only
+		//	@control: true if control is written; used by the read sink only
+		OutFile(const string& fName, const ChromSizesExt& cSizes, BYTE rep = 0, bool control = false);
 
 		// Clone constructor for multithreading
 		//	@oFile: original instance
@@ -654,6 +1054,9 @@ private:
 	
 		~OutFile();
 
+		// Restarts Read numbering
+		inline void ResetReadCounter() { _rCnt = 0; }
+
 		// Start recording chrom
 		void BeginWriteChrom(const RefSeq& seq);
 
@@ -676,6 +1079,17 @@ private:
 		//	@signOut: output marker
 		//	@predicate: 'output' marker
 		void PrintFormat(const char* signOut, const char* predicate) const;
+
+		// Returns estimated size of the chrom's coverage accumulated while generating, in bytes
+		//	@len: chrom's length
+		size_t ChromMemSize(chrlen len) const;
+
+		// Returns size of the clone's I/O buffers in bytes
+		size_t BuffMemSize() const;
+
+		// Preallocates the Read files by the estimated number of Reads
+		//	@rCnt: estimated number of Reads
+		void Reserve(ULLONG rCnt) const;
 	};
 
 	// 'DistrFiles' manages two distribution: fragments and reads
@@ -686,8 +1100,7 @@ private:
 
 		const string _fName = strEmpty;			// common part of frag's/read's distribution file name
 		LenFreq* _dist[ND]{ nullptr,nullptr };	// distributions: fragments (0) and reads (1)
-		function<void(fraglen flen)> _fAddFrag = [](fraglen) {};	// 'add fragment to distribution' function
-		function<void(readlen rlen)> _fAddRead = [](readlen) {};	// 'add read to distribution' function
+		mutex	_merge;							// guards merging thread histograms into distributions
 
 		// Returns file name for fragments (ind=0) and reads (ind=1) distributions
 		const string FileName(BYTE ind) const {
@@ -699,13 +1112,34 @@ private:
 		}
 
 	public:
+		// 'Hists' keeps frag's and read's length histograms filled by a single thread without locking
+		class Hists
+		{
+			friend class DistrFiles;
+			unique_ptr<LenHist> _hist[ND];	// histograms: fragments (0) and reads (1)
+
+		public:
+			// Creates histograms for the distributions set in files
+			Hists(const DistrFiles& files) {
+				for (BYTE i = 0; i < ND; i++)
+					if (files._dist[i])	_hist[i].reset(new LenHist());
+			}
+
+			// Adds frag/read length to histograms
+			inline void AddFrag(fraglen flen, readlen rlen) {
+				if (_hist[0])	_hist[0]->AddLen(flen);
+				if (_hist[1])	_hist[1]->AddLen(rlen);
+			}
+		};
+
 		DistrFiles(const string& fName, bool isFragDist, bool isReadDist);
 
 		// Writes distributions to files and delete them
 		~DistrFiles();
 
-		// Adds frag/read length to statistics
-		void AddFrag(fraglen flen, readlen rlen);
+		// Merges thread's histograms into distributions
+		//	@hists: merged histograms
+		void Merge(const Hists& hists);
 
 		// Prints output file formats
 		//	@signOut: output marker
@@ -731,9 +1165,33 @@ private:
 	
 	unique_ptr<OutFile> _oFiles[2];	// test [0] and control [1] OutFile objects
 	shared_ptr<DistrFiles> _dists;	// frag's & read's distribution; common for duplicates
+	DistrFiles::Hists _hists{ *_dists };	// frag's & read's histograms of this duplicate
 	Random	_rng;					// random generator; needed for Read variable length generation
 	BYTE	_gMode;					// current generation mode as int,
 									// corresponding to the index to call test/control files
+
+	// 'Tier' keeps output files of the nested depth tier
+	struct Tier {
+		ULLONG	Thresh;					// Reads with key hash below threshold are recorded
+		unique_ptr<OutFile> Files[2];	// test [0] and control [1] files
+
+		Tier(ULLONG thresh) : Thresh(thresh) {}
+	};
+
+	static vector<BYTE> Tiers;		// nested depth tiers in percent, in ascending order
+	vector<Tier> _tiers;			// depth tiers output
+	chrid	_cID = Chrom::UnID;		// current chrom; needed for Read key
+	ULONG	_rInd = 0;				// index of recorded Read within chrom; needed for Read key
+
+	// Returns uniformly distributed 32-bit hash of Read key
+	//	@cID: chrom
+	//	@ind: index of Read within chrom
+	static ULLONG KeyHash(chrid cID, ULONG ind) {
+		ULLONG x = (ULLONG(cID) << 40) ^ ind;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return (x ^ (x >> 31)) >> 32;
+	}
 	
 									//static void PrintPairFormat(eFormat f1, eFormat f2, 
 	//	const char* signOut, const char* predicate, const char* type, const string titles[], 
@@ -754,7 +1212,7 @@ private:
 	// Prints item title or count
 	template <typename T>
 	static void PrintItemsSummary(T t1, T t2) {
-		bool isReadFormat = InclReadName() || HasFormat(eFormat::RDENS, eFormat::RDIST);
+		bool isReadFormat = InclReadName() || HasFormat(eFormat::RDENS, eFormat::RDIST, eFormat::REC);
 		if (isReadFormat)
 			cout << t1;
 		if (HasFormat(eFormat::BGR, eFormat::FDENS, eFormat::FDIST)) {
@@ -767,6 +1225,9 @@ public:
 	// Returns true if SAM type is assigned.
 	//static inline bool IsSamSet() { return HasFormat(eFormat::SAM); }
 
+	// Returns number of defined formats
+	static BYTE FormatCount() { return BYTE(OnesCount(Format)); }
+
 	// Initializes static members
 	//	@fFormat: types of output files
 	//	@cmLine: command line to add as a comment in the first file line
@@ -774,17 +1235,37 @@ public:
 	//	@bgStrand: true if bedGraphs with different strands should be generated
 	//	@strandErrProb: the probability of strand error
 	//	@zipped: true if output files should be zipped
-	static void Init(int fFormat, BYTE mapQual, bool bgStrand, float strandErrProb, bool zipped);
+	//	@densBin: density bin length
+	//	@densFixed: true if density should be written in fixedStep format
+	//	@wigMem: memory limit for WIG data waiting for writing, in Mb, or 0 if unlimited
+	//	@bigWig: true if coverage and density should be written in bigWig format
+	static void Init(int fFormat, BYTE mapQual, bool bgStrand, float strandErrProb, bool zipped,
+		chrlen densBin, bool densFixed, UINT wigMem, bool bigWig);
+
+	// Sets output formats, keeping other initialized parameters
+	//	@fFormat: types of output files
+	static void SetFormat(int fFormat);
+
+	// Returns output formats as int
+	inline static int GetFormat() { return Format; }
 
 	// Sets sequense mode.
 	//	@trial: if true, then set empty mode, otherwise current working mode
 	inline static void SetSeqMode(bool trial)	{ OutFile::SetSeqMode(trial); }
 
+	// Returns true if no output format needs nucleotides:
+	// only BG, FDENS, RDENS, FDIST, RDIST, or BED without N-limit are set
+	inline static bool IsSeqFree() { return seqFree; }
+
 	// Sets Read quality pattern by valid file name.
 	inline static void SetReadQualPatt(const char* rqPattFName) { 
 		DataOutFile::Init(rqPattFName);
 	}
 
+	// Sets nested depth tiers
+	//	@tiers: tiers in percent, in ascending order, excluding full depth
+	inline static void SetTiers(const vector<BYTE>& tiers) { Tiers = tiers; }
+
 	// Prints item title ("reads/fragments") according to output formats
 	static void PrintItemTitle();
 
@@ -797,21 +1278,41 @@ public:
 	//	@control: if true, then control ('input') is generated
 	//	@cmLine: command line to add as a comment in the first file line
 	//	@cSizes: chrom sizes, or NULL
-	Output(const string& fName, bool control, const string& cmLine, const ChromSizesExt& cSizes);
+	//	@rep: replicate; used by the read sink only
+	Output(const string& fName, bool control, const string& cmLine, const ChromSizesExt& cSizes,
+		BYTE rep = 0);
 
 	// Clone constructor for multithreading.
 	//	@file: original instance
 	Output(const Output& file);
+
+	// Merges histograms of this duplicate into the common distributions
+	~Output() { _dists->Merge(_hists); }
+
+	// Returns estimated size of the chrom's coverage accumulated while generating, in bytes
+	//	@len: chrom's length
+	size_t ChromMemSize(chrlen len) const;
+
+	// Returns size of the clone's I/O buffers in bytes
+	size_t BuffMemSize() const;
+
+	// Preallocates the Read files by the estimated numbers of Reads
+	//	@tCnt: estimated number of Test Reads
+	//	@cCnt: estimated number of Control Reads
+	void Reserve(ULLONG tCnt, ULLONG cCnt) const;
 	
 	 // Set generation mode
 	//	@testMode: if true, set Test mode, otherwhise Control mode
 	inline void SetGMode(GM::eMode gm) { _gMode = BYTE(gm); }
 
 	// Starts recording chrom
-	void BeginWriteChrom(const RefSeq& seq);
+	//	@seq: chrom's sequence
+	//	@all: if true then starts both Test and Control files, otherwise the files of the current mode only
+	void BeginWriteChrom(const RefSeq& seq, bool all = true);
 
 	// Stops recording chrom
-	void EndWriteChrom();
+	//	@all: if true then stops both Test and Control files, otherwise the files of the current mode only
+	void EndWriteChrom(bool all = true);
 
 	// Adds read(s) to output file
 	//	@pos: current fragment's position
@@ -823,6 +1324,15 @@ public:
 	//			-1: N limit is exceeded; Read(s) is(are) not added
 	int AddRead(chrlen pos, fraglen flen, /*Gr::eType g,*/ bool reverse);
 
+	// Renders binary Read records into the set formats, treating chroms concurrently
+	//	@file: records file
+	//	@cSizes: chrom sizes with treated chroms which have records
+	//	@thrCnt: number of threads
+	//	@ctrlFile: control records file rendered into control output, or NULL
+	//	return: number of rendered records
+	ULLONG Render(const RecInFile& file, const ChromSizesExt& cSizes, thrid thrCnt,
+		const RecInFile* ctrlFile = NULL);
+
 	// Prints output file formats and sequencing mode
 	//	@signOut: output marker
 	void PrintFormat	(const char* signOut) const;
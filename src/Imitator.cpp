@@ -14,6 +14,7 @@ Provides chip-seq imitation functionality
 #include <cwchar>		// long '-'
 #include <random>		// std::exponential_distribution
 #include <thread>
+#include <chrono>
 
 const char* Gr::title[] = { "FG","BG" };	// if change, correct TitleLength
 
@@ -145,18 +146,22 @@ public:
 		};
 		const BYTE commsCnt = sizeof(comms)/sizeof(char*);
 		BYTE i = 0;
+		const string tmpName = FS::TmpFileName(_fName);	// concurrent runs may share service dir
 		ofstream file;
 
-		file.open (_fName.c_str(), ios_base::out);
+		file.open (tmpName.c_str(), ios_base::out);
 		file << "# info for sampling generated by isChIP; do not change. Fragment length:\n";
+		// averages are saved exactly, so the next runs sample the same as the one that calculated them
+		file << setprecision(numeric_limits<float>::max_digits10);
 		//for(vector<AvrFrag>::iterator it = _avrs.begin(); it != _avrs.end(); it++) {
 		sort(_avrs.begin() + 1, _avrs.end());
 		for(_it = _avrs.begin(); _it != _avrs.end(); _it++) {
 			file << _it->ReadLen << TAB << _it->SelLen << TAB << _it->RecLen << TAB << _it->MdaLen;
 			if(i < commsCnt)	file << TAB << comms[i++];
-			file << setprecision(2) << fixed << LF;
+			file << LF;
 		}
 		file.close();
+		FS::CommitFile(tmpName, _fName);
 	}
 
 	// Returns records for current Read len
@@ -164,8 +169,11 @@ public:
 	{
 		if(_avrs.size()) {
 			for(_it=_avrs.begin() + 1; _it<_avrs.end(); _it++)
-				if(_it->ReadLen == Read::FixedLen)
+				if(_it->ReadLen == Read::FixedLen) {
+					// recorded averages may be saved infinite by the previous versions: recalculate them
+					if(isinf(_it->RecLen))	*_it = AvrFrag(), _isChanged = true;
 					return *_it;
+				}
 			_avrs.emplace_back();
 			_isChanged = true;
 			return *(_it = _avrs.end() - 1);
@@ -207,13 +215,13 @@ public:
 
 /************************ AvrFrags: end ************************/
 
-// Thread-safety increment sizes by RefSeq
-void Imitator::GenomeSizes::IncrSizes(const RefSeq& seq)
+// Thread-safety increment sizes by another sizes
+void Imitator::GenomeSizes::IncrSizes(const GenomeSizes& sizes)
 {
 	Mutex::Lock(Mutex::eType::INCR_SUM);
-	Total += seq.Length();
-	Defined += seq.DefRegion().Length();
-	Gaps += seq.GapLen();
+	Total += sizes.Total;
+	Defined += sizes.Defined;
+	Gaps += sizes.Gaps;
 	Mutex::Unlock(Mutex::eType::INCR_SUM);
 }
 
@@ -237,6 +245,7 @@ void Imitator::GenomeSizes::IncrSizes(const RefSeq& seq)
 const char* Imitator::ChromView::tGapsExcl = "g_excl";
 const char* Imitator::ChromView::tTime = "mm:ss";
 BYTE Imitator::ChromView::GapsWexcl;
+BYTE Imitator::ChromView::MarkW = 2;
 
 // Prints str on given field and return field width
 //	@width: field width
@@ -365,6 +374,15 @@ void Imitator::ChromView::Init(ULONG maxCnt, float sample, float maxDens)
 	GapsWexcl = BYTE(strlen(tGapsExcl));
 }
 
+// Sets the width of chrom's mark field by the longest treated chrom's mark
+//	@cSizes: chrom sizes
+void Imitator::ChromView::SetChromNameW(const ChromSizesExt& cSizes)
+{
+	for(ChromSizes::cIter it=cSizes.cBegin(); it!=cSizes.cEnd(); it++)
+		if(cSizes.IsTreated(it) && Chrom::Mark(CID(it)).length() > MarkW)
+			MarkW = BYTE(Chrom::Mark(CID(it)).length());
+}
+
 #ifdef DEBUG
 void Imitator::ChromView::Print(ULONG maxCnt)
 {
@@ -404,14 +422,14 @@ void Imitator::ChromCutter::SetGMode(GM::eMode gmode)
 bool Imitator::ChromCutter::IncrRecFragCount(Gr::eType g, bool primer)
 {
 	_fragCnt[g].RecIncr(primer);	// incr of local recorded Reads
-	return GlobContext[int(_gMode)].IncrRecFragCount(g, primer);
+	return RepContext(_rep, _gMode).IncrRecFragCount(g, primer);
 }
 
 // Increments counter of total selected fragments thread-safely
 void Imitator::ChromCutter::IncrTotalSelFragCount()
 {
 	for(BYTE i=0; i<Gr::Cnt; i++)
-		GlobContext[int(_gMode)].fCnts[i].SelAddSaved(_fragCnt[i].SelCnt());
+		RepContext(_rep, _gMode).fCnts[i].SelAddSaved(_fragCnt[i].SelCnt());
 }
 
 // Creates instance
@@ -423,12 +441,18 @@ Imitator::ChromCutter::ChromCutter(const Imitator* imitator, Average* avr, bool
 	_ampl(_fragDistr),
 	_fragDistr(avr),
 	_master(master),
-	_gMode(GM::eMode::Test)
+	_gMode(GM::eMode::Test),
+	_win(0, CHRLEN_MAX)
 {
 	Output::SetSeqMode(avr);
 	_fragCnt.Clear();
 	_fragCnt.SetGMode(GM::eMode::Test);
-	_output = master ? &(imitator->_oFile) : new Output(imitator->_oFile);
+	// trial instance needs the only output
+	for(const auto& o : imitator->_oFiles) {
+		_outputs.push_back(master ? o.get() : new Output(*o));
+		if(avr)		break;
+	}
+	_output = _outputs[0];
 }
 
 // Prints thread-safe info about treated chroms and stops timer
@@ -439,12 +463,12 @@ Imitator::ChromCutter::ChromCutter(const Imitator* imitator, Average* avr, bool
 void Imitator::ChromCutter::PrintChrom (
 	const RefSeq& seq, chrlen enrRegLen, Timer& timer, bool excLimit)
 {
-	if( !Verbose(eVerb::RT) )	return;
+	if( !Verbose(eVerb::RT) || !ChromRows )	return;
 
 	Mutex::Lock(Mutex::eType::OUTPUT);
 
-	const ULONG rgnLens[] = { enrRegLen, seq.DefRegion().Length() - enrRegLen }; // FG, BG region's lengths
-	PrintChromInfo(seq.ID(), _gMode, _fragCnt.GetFragCnts(), rgnLens, !IsSingleThread());
+	const ULONG rgnLens[] = { enrRegLen, GenomeSizes(seq).DefLength() - enrRegLen }; // FG, BG region's lengths
+	PrintChromInfo(seq.ID(), _gMode, _rep, _fragCnt.GetFragCnts(), rgnLens, !IsSingleThread());
 	if(Verbose(eVerb::PAR))
 		if(_gMode == GM::eMode::Test) {
 			const GenomeSizes s(seq);
@@ -455,7 +479,7 @@ void Imitator::ChromCutter::PrintChrom (
 	if(excLimit) {
 		cout << " exceeded limit";
 		if(!Verbose(eVerb::PAR))
-			cout << " of " << Seq::ReadsLimit() << SPACE << FT::ItemTitle(FT::eType::ABED, true);
+			cout << " of " << (FragsLimit << int(Seq::IsPE())) << SPACE << FT::ItemTitle(FT::eType::ABED, true);
 	}
 	cout << endl;
 	
@@ -465,69 +489,155 @@ void Imitator::ChromCutter::PrintChrom (
 ULONG Imitator::ChromCutter::PrepareCutting(GM::eMode gm, chrid cID, Timer& timer)
 {
 	SetGMode(gm);
-	PrintChromName(cID, gm, IsSingleThread());			// print chrom name before cutting
+	PrintChromName(cID, gm, _rep, IsSingleThread() && ChromRows);	// print chrom name before cutting
 	timer.Start();
 	return ULONG(CellCnt(gm)) << ULONG(Chrom::IsAutosome(cID));	// multiply twice for autosomes
 }
 
-// Treats chromosomes given for current thread
-//	@cSubset: pointer to Subset - set of chrom IDs treated in this thread
-void Imitator::ChromCutter::Execute(const effPartition::Subset& cIDSet)
+// Sets current window and moves the fragment start to the window's margin if it is behind
+//	@win: window
+//	@fStart: fragment start position
+void Imitator::ChromCutter::SetWindow(const Region& win, chrlen& fStart)
 {
+	const chrlen margin = Windows::Margin();
+
+	_win = win;
+	if(win.Start > margin && fStart < win.Start - margin)
+		fStart = win.Start - margin + _fragDistr.RandFragLen();
+}
+
+// Treats chromosomes taken from the scheduler
+//	@sched: chroms scheduler
+//	@tID: thread ID
+void Imitator::ChromCutter::Execute(Scheduler& sched, thrid tID)
+{
+	static const vector<Region> wholeChrom{ Region(0, CHRLEN_MAX) };	// the single window
 	Features::cIter	cit;			// template chrom's iterator
 	ULONG	n, cellCnt;				// count of cells, length of enriched regions
 	chrlen	currPos, k, fCnt;		// count of features
 	chrlen	enrRegLen;				// length of enriched regions
+	chrid	cID;
+	GM::eMode gm;					// task's mode
+	float	cost;					// chrom's model cost
+	bool	whole;					// true if all chrom's replicates are generated completely
+	bool	lim;					// true if chrom's replicate is cut by Reads limit
+	size_t	w;						// window's index
 	int		res = 0;				// result of cutting
+	BYTE	activeCnt = RepCnt;		// number of replicates whose Reads limit is not achieved
+	vector<bool> limited(RepCnt, false);	// true for replicate whose Reads limit is achieved
 	Timer	timer(Verbose(eVerb::RT));	// print local time on Verbose 'runtime info and above'
 
 	try {
-		for (chrid cID : cIDSet.NumbIDs()) {	// loop through chroms
-			_fragCnt.Clear();
-			cellCnt = PrepareCutting(GM::eMode::Test, cID, timer);
-
+		while (sched.Next(tID, cID, gm, cost)) {	// loop through chroms
+			const auto start = chrono::steady_clock::now();
+			whole = true;
 			if(Templ && (cit=Templ->GetIter(cID)) != Templ->cEnd()) {
 				fCnt = Templ->ItemsCount(cID);
-				enrRegLen = Templ->EnrRegnLength(cit, 0, SelFragAvr);
+				enrRegLen = Wins ? Wins->Length(cID, *Templ) : Templ->EnrRegnLength(cit, 0, SelFragAvr);
 			}
 			else	enrRegLen = fCnt = 0;
-			const RefSeq seq(cID, _cSizes);
-			const chrlen cLen = seq.End();		// chrom 'end' position
+			const vector<Region>& wins = Wins ? *Wins->Find(cID) : wholeChrom;
+			vector<chrlen> wFirst(wins.size(), 0);	// index of the first feature reached by each window
+			if(Wins)
+				for(w = 0, k = 0; w < wins.size(); w++) {
+					while(k < fCnt && Templ->Feature(cit, k).End + Windows::Margin() < wins[w].Start)	k++;
+					wFirst[w] = k;
+				}
+			shared_ptr<RefSeq> seq;		// loaded once for all replicates, shared with Control task if any
+			bool tested = false;		// true if at least one Test replicate is generated
 			float scores[]{ 1,1 };
-			
-			_output->BeginWriteChrom(seq);
-			for(n = 0; n < cellCnt; n++) {
-				currPos = seq.Start() + _fragDistr.RandFragLen();	// random shift from the beginning
-				for(k=0; k < fCnt; k++)
-					if(res = CutChrom(cLen, currPos, Templ->Feature(cit, k), scores, false))
-						goto A;			// achievement of Reads limit
-				// add background after last 'end' position
-				if((res = CutChrom(cLen, currPos, seq.DefRegion(), scores, true)) < 0)
-					break;				// achievement of Reads limit
-			}
-A:			PrintChrom(seq, enrRegLen, timer, res < 0);		// timer stops and printed in here
-			IncrTotalSelFragCount();
-			// collect total enriched regions length to calculate total density
-			IncrementTotalLength(seq, enrRegLen);
-			if(MakeControl) {
-				cellCnt = PrepareCutting(GM::eMode::Control, seq.ID(), timer);
-				for(n = 0; n < cellCnt; n++) {
-					currPos = seq.Start() + _fragDistr.RandFragLen();	// random shift from the beginning
-					CutChrom(cLen, currPos, seq.DefRegion(), scores, true);
+			auto loadSeq = [&]() {
+				if(seq)		return;
+				if(sched.IsSplit())		seq = sched.Seq(cID);
+				// the arena keeps the buffer between chroms, which is not counted by the memory budget
+				else	seq = LoadSeq(cID, _cSizes, MemLimit ? NULL : &_arena);
+			};
+
+			for (BYTE r = 0; r < RepCnt; r++) {		// loop through replicates
+				if(IsSkipped(r, cID))	{ whole = false; continue; }
+				// Control is not cut by the Test's Reads limit,
+				// so it doesn't depend on the timing of the Test and Control tasks
+				const bool test = gm == GM::eMode::Test && !limited[r];
+				const bool control = MakeControl && (gm == GM::eMode::Control || !sched.IsSplit());
+				if(!test && gm == GM::eMode::Test)	whole = false;
+				if(!test && !control)	continue;
+				SetReplicate(r);
+				_fragCnt.Clear();
+				res = 0;
+				if(test) {
+					// chrom replicate's own random stream: the result doesn't depend on the chroms
+					// distribution among threads or shards, nor on the resumed replicates
+					_fragDistr.Reset(ULONG(r) << 16 | cID);
+					cellCnt = PrepareCutting(GM::eMode::Test, cID, timer);
+					loadSeq();
+					const chrlen cLen = seq->End();		// chrom 'end' position
+
+					_output->BeginWriteChrom(*seq, false);
+					for(n = 0; n < cellCnt; n++) {
+						currPos = seq->Start() + _fragDistr.RandFragLen();	// random shift from the beginning
+						for(w = k = 0; w < wins.size(); w++) {
+							SetWindow(wins[w], currPos);
+							for(k = max(k, wFirst[w]); k < fCnt; k++) {
+								const Featr& ft = Templ->Feature(cit, k);
+								if(ft.Start > _win.End)	break;
+								if(res = CutChrom(cLen, currPos, ft, scores, false))
+									goto A;		// achievement of Reads limit
+								if(ft.End > _win.End)	break;		// feature is continued in the next window
+							}
+							// add background after last 'end' position
+							if((res = CutChrom(cLen, currPos, seq->DefRegion(), scores, true)) < 0)
+								goto A;			// achievement of Reads limit
+						}
+					}
+A:					PrintChrom(*seq, enrRegLen, timer, res < 0);	// timer stops and printed in here
+					tested = true;
+					IncrTotalSelFragCount();
+					_output->EndWriteChrom(false);
+				}
+				if(control) {
+					// own stream, so Control doesn't depend on whether it is generated by a separate task
+					_fragDistr.Reset(ULONG(GM::eMode::Control) << 24 | ULONG(r) << 16 | cID);
+					cellCnt = PrepareCutting(GM::eMode::Control, cID, timer);
+					loadSeq();
+					const chrlen cLen = seq->End();		// chrom 'end' position
+
+					_output->BeginWriteChrom(*seq, false);
+					for(n = 0; n < cellCnt; n++) {
+						currPos = seq->Start() + _fragDistr.RandFragLen();	// random shift from the beginning
+						for(const Region& win : wins) {
+							SetWindow(win, currPos);
+							CutChrom(cLen, currPos, seq->DefRegion(), scores, true);
+						}
+					}
+					PrintChrom(*seq, enrRegLen, timer, false);		// timer stops in here
+					IncrTotalSelFragCount();
+					_output->EndWriteChrom(false);
+				}
+				lim = res < 0;
+				// chrom's replicate is completed when both of its split tasks are completed
+				if((Jrnl || Cch) && (sched.IsSplit() ? sched.Join(cID, r, gm, _fragCnt, lim) : test)) {
+					const Journal::Rec rec{ r, cID, enrRegLen, GenomeSizes(*seq), _fragCnt };
+					if(Jrnl)	Jrnl->Add(rec);
+					if(Cch && !lim)	Cch->Add(rec);	// chrom cut by Reads limit depends on others
 				}
-				PrintChrom(seq, enrRegLen, timer, false);		// timer stops in here
-				IncrTotalSelFragCount();
+				if(res < 0)		limited[r] = true, activeCnt--, whole = false;	// achievement of Reads limit
 			}
-			_output->EndWriteChrom();
-			if(res < 0)		break;			// achievement of Reads limit
+			// collect total enriched regions length to calculate total density:
+			// once per chrom generated by the Test task, unless it is restored
+			if(tested && !RestoredIDs.count(cID))
+				IncrementTotalLength(*seq, enrRegLen);
+			if(whole)
+				sched.Done(cID, cost, chrono::duration<float>(chrono::steady_clock::now() - start).count());
+			if(!activeCnt && !MakeControl)	break;	// Control is generated for all chroms
 		}
 	}
-	catch(const Err &e)			{ Terminate(cIDSet.ID(), e.what()); }
-	catch(const exception &e)	{ Terminate(cIDSet.ID(), e.what()); }
-	catch(...)					{ Terminate(cIDSet.ID(), "Unregistered error in thread"); }
+	catch(const Err &e)			{ Terminate(tID, e.what()); }
+	catch(const exception &e)	{ Terminate(tID, e.what()); }
+	catch(...)					{ Terminate(tID, "Unregistered error in thread"); }
+	sched.Release(tID);
 	if(!IsSingleThread() && Verbose(eVerb::DBG))	{
 		Mutex::Lock(Mutex::eType::OUTPUT);
-		cout << SignDbg << sThread << int(cIDSet.ID()) << ":  end" << endl;
+		cout << SignDbg << sThread << int(tID) << ":  end" << endl;
 		Mutex::Unlock(Mutex::eType::OUTPUT);
 	}
 }
@@ -574,13 +684,14 @@ int Imitator::ChromCutter::CutChrom	(
 							// [2],[3] - additional fragments generated by EXO
 
 	scores[0] = ft.Value;
-	for(fraglen	fLen = 0; fStart<=ft.End; fStart += fLen + 1) {	// ChIP: control right mark
+	for(fraglen	fLen = 0; fStart<=ft.End && fStart<_win.End; fStart += fLen + 1) {	// ChIP: control right mark
 		fLen = _fragDistr.LognormNext();
 		chrlen fEnd = fStart + fLen;						// fragment's end position
 		if(fEnd > cLen)	
 			if(fStart >= cLen - Read::FixedLen)	return 1;	// end of chrom
 			else	fLen = (fEnd = cLen) - fStart;			// cut last fragment
-		
+		if(fEnd <= _win.Start)	continue;					// fragment upstream of the window
+
 		if(DistrParams::IsSS())								// get next size seletion limits?
 			_fragDistr.SizeSelLimits(fLenMin, fLenMax);
 		/*
@@ -646,35 +757,728 @@ int Imitator::ChromCutter::CutChrom	(
 
 /************************ end of class ChromCutter ************************/
 
+/************************  class Windows ************************/
+
+// Returns total length of the chrom's windows overlapping the region
+//	@wins: sorted chrom's windows
+//	@rgn: tested region
+chrlen Imitator::Windows::Length(const vector<Region>& wins, const Region& rgn)
+{
+	chrlen len = 0;
+
+	for (const Region& win : wins) {
+		if (win.Start >= rgn.End)	break;
+		if (win.End > rgn.Start)
+			len += min(win.End, rgn.End) - max(win.Start, rgn.Start);
+	}
+	return len;
+}
+
+// Returns length of the margin upstream of each window
+chrlen Imitator::Windows::Margin()
+{
+	// the boundaries of fragments forget the start position after a few fragments
+	return chrlen(10 * DistrParams::LnMean());
+}
+
+// Sorts windows and joins the overlapping ones
+void Imitator::Windows::Normalize()
+{
+	for (auto& c : *this) {
+		vector<Region>& wins = c.second;
+
+		sort(wins.begin(), wins.end(), Region::CompareByStartPos);
+		size_t i = 0;
+		for (size_t j = 1; j < wins.size(); j++)
+			if (wins[j].Start <= wins[i].End) {
+				if (wins[j].End > wins[i].End)	wins[i].End = wins[j].End;
+			}
+			else	wins[++i] = wins[j];
+		wins.resize(i + 1);
+	}
+}
+
+// Returns count of windows
+size_t Imitator::Windows::Count() const
+{
+	size_t cnt = 0;
+	for (const auto& c : *this)		cnt += c.second.size();
+	return cnt;
+}
+
+// Returns sorted IDs of chroms with windows
+vector<chrid> Imitator::Windows::ChromIDs() const
+{
+	vector<chrid> cIDs;
+	for (const auto& c : *this)		cIDs.push_back(c.first);
+	return cIDs;
+}
+
+// Returns chrom's windows, or NULL if there are none
+//	@cID: chrom's ID
+const vector<Region>* Imitator::Windows::Find(chrid cID) const
+{
+	const auto it = find(cID);
+	return it != end() ? &it->second : NULL;
+}
+
+// Returns total length of the chrom's windows overlapping the region
+//	@cID: chrom's ID
+//	@rgn: tested region
+chrlen Imitator::Windows::Length(chrid cID, const Region& rgn) const
+{
+	const vector<Region>* wins = Find(cID);
+	return wins ? Length(*wins, rgn) : 0;
+}
+
+// Returns total length of the chrom's features inside the windows
+//	@cID: chrom's ID
+//	@ftrs: features
+chrlen Imitator::Windows::Length(chrid cID, const Features& ftrs) const
+{
+	const vector<Region>* wins = Find(cID);
+	const auto cit = ftrs.GetIter(cID);
+	chrlen len = 0;
+
+	if (wins && cit != ftrs.cEnd())
+		for (chrlen k = 0; k < ftrs.ItemsCount(cID); k++)
+			len += Length(*wins, ftrs.Feature(cit, k));
+	return len;
+}
+
+/************************ end of class Windows ************************/
+
+/************************  class Scheduler ************************/
+
+const char* Imitator::Scheduler::FName = "timing";
+const float Imitator::Scheduler::FtrCost = 2000;
+const float Imitator::Scheduler::FmtCost = 0.25f;
+
+// Returns model cost of chrom's generation in the stated mode
+//	@cSizes: chrom sizes
+//	@it: chrom's iterator
+//	@gm: generation mode
+float Imitator::Scheduler::Cost(const ChromSizesExt& cSizes, ChromSizes::cIter it, GM::eMode gm)
+{
+	const chrid cID = CID(it);
+	const float len = float(Wins ?
+		Wins->Length(cID, Region(0, CHRLEN_MAX)) << int(Chrom::IsAutosome(cID)) :
+		cSizes.DefEffLength(it));	// effective length: doubled for autosomes
+	const chrlen fCnt = Templ && Templ->GetIter(cID) != Templ->cEnd() ? Templ->ItemsCount(cID) : 0;
+	const float cost = gm == GM::eMode::Test ?
+		CellCnt(gm) * (len + FtrCost * fCnt) :
+		CellCnt(gm) * len;
+
+	return cost * RepCnt * (1 + FmtCost * Output::FormatCount());
+}
+
+// Returns estimated memory footprint of chrom's generation in bytes
+//	@cSizes: chrom sizes
+//	@it: chrom's iterator
+//	@oFiles: output files of each replicate
+size_t Imitator::Scheduler::Footprint(
+	const ChromSizesExt& cSizes, ChromSizes::cIter it, const vector<unique_ptr<Output>>& oFiles)
+{
+	const chrlen len = Wins ?	// coverage blocks are allocated near the windows only
+		Wins->Length(CID(it), Region(0, CHRLEN_MAX)) + 2 * Windows::Margin() : cSizes[CID(it)];
+	size_t size = Output::IsSeqFree() ? 0 : cSizes[CID(it)];	// sequence is loaded entirely
+
+	for(const auto& o : oFiles)		size += o->ChromMemSize(len);
+	return size;
+}
+
+// Sets the memory budget of the chroms, reducing I/O buffers and coverage held for output to fit the limit
+//	@thrCnt: number of threads
+//	@oFiles: output files of each replicate
+void Imitator::Scheduler::SetBudget(thrid thrCnt, const vector<unique_ptr<Output>>& oFiles)
+{
+	auto buffSize = [&]() {		// I/O buffers of all threads
+		size_t size = 0;
+		for(const auto& o : oFiles)		size += o->BuffMemSize();
+		return thrCnt * size;
+	};
+	const size_t buffLimit = MemLimit / 8;		// limit of I/O buffers
+	size_t size = buffSize();
+
+	// I/O buffers of the clones are created by the threads, after the budget is set
+	if(size > buffLimit) {
+		TxtFile::CloneBuffLen = max(TxtFile::MinCloneBuffLen,
+			size_t(float(TxtFile::CloneBuffLen) * buffLimit / size) & ~size_t(0xFFF));
+		size = buffSize();
+	}
+	// completed coverage waiting for the sorted output is spilled beyond its limit
+	if(!CoverOutFile::MemLimit || CoverOutFile::MemLimit > MemLimit / 4)
+		CoverOutFile::MemLimit = MemLimit / 4;
+	size += CoverOutFile::MemLimit;
+	_memLimit = MemLimit > size ? MemLimit - size : 1;	// minimal budget: one chrom at a time
+}
+
+// Reads timing profile
+void Imitator::Scheduler::Load()
+{
+	if(!FS::IsFileExist(_fName.c_str()))	return;
+	TabFile file(_fName, FT::eType::INI, TxtFile::eAction::READ_ANY);
+	while(file.GetNextLine())
+		_rates[chrid(file.IntField(0))] = file.FloatField(1);
+}
+
+// Creates instance and distributes treated chroms among the threads
+//	@cSizes: chrom sizes
+//	@thrCnt: number of threads
+//	@oFiles: output files of each replicate
+Imitator::Scheduler::Scheduler(const ChromSizesExt& cSizes, thrid thrCnt,
+	const vector<unique_ptr<Output>>& oFiles)
+	: _cSizes(cSizes), _split(MakeControl && thrCnt > 1),
+	_queues(thrCnt), _loads(thrCnt, 0), _held(thrCnt, 0), _busy(thrCnt, false)
+{
+	chrid oversized = 0;	// number of chroms exceeding the memory budget
+
+	if(MemLimit)	SetBudget(thrCnt, oFiles);
+	if(cSizes.ServPath().length()) {
+		_fName = cSizes.ServPath() + FName + FT::Ext(FT::eType::INI);
+		Load();
+	}
+
+	vector<Task> tasks;
+	float rate = 0;		// average rate of the profiled chroms, applied to the new ones
+
+	for(const auto& r : _rates)	rate += r.second;
+	rate = _rates.size() ? rate / _rates.size() : 1;
+	tasks.reserve(cSizes.TreatedCount() << int(_split));
+	for(ChromSizes::cIter it = cSizes.cBegin(); it != cSizes.cEnd(); it++)
+		if(cSizes.IsTreated(it)) {
+			const auto itr = _rates.find(CID(it));
+			// both tasks hold the whole chrom's footprint: the sequence is shared while any of them is treated
+			const size_t mem = _memLimit ? Footprint(cSizes, it, oFiles) : 0;
+			auto addTask = [&](GM::eMode gm, float cost) {
+				tasks.push_back({ CID(it), gm, cost,
+					cost * (itr == _rates.end() ? rate : itr->second) / 1e9f, mem });
+			};
+			float cost = Cost(cSizes, it, GM::eMode::Test);
+
+			if(_split) {
+				Pair& pair = _pairs[CID(it)];
+				pair.Cnts.resize(RepCnt);
+				pair.Done.resize(RepCnt, false);
+				pair.Limited.resize(RepCnt, false);
+				addTask(GM::eMode::Control, Cost(cSizes, it, GM::eMode::Control));
+			}
+			else if(MakeControl)	cost += Cost(cSizes, it, GM::eMode::Control);
+			addTask(GM::eMode::Test, cost);
+			if(mem > _memLimit)		oversized++;
+		}
+	if(oversized)
+		Err(to_string(oversized) + SPACE + Chrom::Title(oversized > 1)
+			+ " exceed the memory limit and will be generated one at a time", "--mem-limit").Warning();
+	// longest processing time first: each task goes to the least loaded queue;
+	// a single thread keeps the chroms order in the output
+	if(thrCnt > 1)
+		sort(tasks.begin(), tasks.end(), [](const Task& t1, const Task& t2) { return t1.Time > t2.Time; });
+	for(const Task& t : tasks) {
+		const thrid i = thrid(min_element(_loads.begin(), _loads.end()) - _loads.begin());
+		_queues[i].push_back(t);
+		_loads[i] += t.Time;
+	}
+}
+
+// Writes refined timing profile
+Imitator::Scheduler::~Scheduler()
+{
+	if(!_fName.length() || !_done.size())	return;
+
+	for(const auto& d : _done) {
+		const float rate = d.second.second * 1e9f / d.second.first;
+		auto it = _rates.find(d.first);
+		if(it == _rates.end())	_rates[d.first] = rate;
+		else	it->second = (it->second + rate) / 2;	// smooth the variation between runs
+	}
+	const char* comm = "[1]:chrom ID; [2]:time per cost unit, ns; [3]:last time, s; [4]:chrom";
+	const string tmpName = FS::TmpFileName(_fName);	// concurrent runs may share service dir
+	ofstream file;
+
+	file.open(tmpName.c_str(), ios_base::out);
+	file << "# timing profile generated by isChIP; do not change\n";
+	for(const auto& r : _rates) {
+		const auto it = _done.find(r.first);
+		file << int(r.first) << TAB << r.second << TAB << (it == _done.end() ? 0 : it->second.second)
+			 << TAB << Chrom::AbbrName(r.first);
+		if(comm)	file << TAB << comm, comm = NULL;
+		file << LF;
+	}
+	file.close();
+	FS::CommitFile(tmpName, _fName);
+}
+
+// Takes the next chrom to treat
+//	@tID: thread ID
+//	@cID: taken chrom's ID
+//	@cost: taken chrom's model cost
+//	return: false if there are no more chroms
+bool Imitator::Scheduler::Next(thrid tID, chrid& cID, GM::eMode& gm, float& cost)
+{
+	unique_lock<mutex> lock(_lock);
+	Task task;
+
+	Free(tID);
+	while(!Take(tID, task)) {
+		if(none_of(_queues.begin(), _queues.end(), [](const deque<Task>& q) { return q.size(); }))
+			return false;
+		_released.wait(lock);
+	}
+	_busy[tID] = true;
+	_running++;
+	_memUsed += _held[tID] = task.Mem;
+	cID = task.ID;
+	gm = task.Mode;
+	cost = task.Cost;
+	return true;
+}
+
+// Thread-safety returns chrom's sequence shared by its Test and Control tasks,
+// loaded by the first of them
+//	@cID: chrom's ID
+shared_ptr<RefSeq> Imitator::Scheduler::Seq(chrid cID)
+{
+	Pair& pair = _pairs.at(cID);		// pairs are not added while treating
+	lock_guard<mutex> lock(pair.Lock);	// the other task waits for the loading
+	shared_ptr<RefSeq> seq = pair.Seq.lock();
+
+	if(!seq) {
+		// the arena keeps the buffer between chroms, which is not counted by the memory budget
+		if(MemLimit || Resident::On)	seq = LoadSeq(cID, _cSizes);
+		else {
+			SeqArena* arena;
+			{
+				lock_guard<mutex> lock(_lock);
+				if(_freeArenas.empty()) {
+					_arenas.emplace_back(new SeqArena);
+					_freeArenas.push_back(_arenas.back().get());
+				}
+				arena = _freeArenas.back();
+				_freeArenas.pop_back();
+			}
+			seq.reset(new RefSeq(cID, _cSizes, !Output::IsSeqFree(), arena),
+				[this, arena](RefSeq* s) {
+					delete s;
+					lock_guard<mutex> lock(_lock);
+					_freeArenas.push_back(arena);
+				});
+		}
+		pair.Seq = seq;
+	}
+	return seq;
+}
+
+// Thread-safety joins the counters of the chrom's replicate generated by its Test and Control tasks
+//	@cID: chrom's ID
+//	@rep: replicate
+//	@gm: completed task's mode
+//	@cnts: completed task's counters; on return the joined ones if the other task is completed
+//	@limited: true if Test is cut by the Reads limit; on return the same for the joined tasks
+//	return: true if the other task is completed as well
+bool Imitator::Scheduler::Join(chrid cID, BYTE rep, GM::eMode gm, FragCnts& cnts, bool& limited)
+{
+	Pair& pair = _pairs.at(cID);
+	lock_guard<mutex> lock(pair.Lock);
+
+	if(limited)		pair.Limited[rep] = true;
+	else	limited = pair.Limited[rep];
+	if(!pair.Done[rep]) {
+		pair.Done[rep] = true;
+		pair.Cnts[rep].Assign(cnts, gm);
+		return false;
+	}
+	cnts.Assign(pair.Cnts[rep], gm == GM::eMode::Test ? GM::eMode::Control : GM::eMode::Test);
+	return true;
+}
+
+// Takes the first chrom fitting into the memory budget: from the front of the own queue,
+// then from the back of the other queues, the most loaded first
+//	@tID: thread ID
+//	@task: taken chrom
+//	return: false if there is no fitting chrom
+bool Imitator::Scheduler::Take(thrid tID, Task& task)
+{
+	const auto fits = [this](const Task& t) {
+		return !_memLimit || !_running || _memUsed + t.Mem <= _memLimit;
+	};
+	deque<Task>& own = _queues[tID];
+	vector<thrid> victims;
+
+	for(auto it = own.begin(); it != own.end(); it++)
+		if(fits(*it)) {
+			task = *it;
+			own.erase(it);
+			_loads[tID] -= task.Time;
+			return true;
+		}
+	for(thrid i = 0; i < _queues.size(); i++)
+		if(i != tID && _queues[i].size())	victims.push_back(i);
+	sort(victims.begin(), victims.end(), [this](thrid i, thrid j) { return _loads[i] > _loads[j]; });
+	for(thrid i : victims) {		// steal
+		deque<Task>& queue = _queues[i];
+		for(auto it = queue.rbegin(); it != queue.rend(); it++)
+			if(fits(*it)) {
+				task = *it;
+				queue.erase(next(it).base());
+				_loads[i] -= task.Time;
+				if(Verbose(eVerb::DBG)) {
+					Mutex::Lock(Mutex::eType::OUTPUT);
+					cout << SignDbg << sThread << int(tID) << ": steals " << Chrom::AbbrName(task.ID)
+						<< (task.Mode == GM::eMode::Control ? " input" : strEmpty) << " from " << sThread << int(i) << endl;
+					Mutex::Unlock(Mutex::eType::OUTPUT);
+				}
+				return true;
+			}
+	}
+	return false;
+}
+
+// Releases the memory taken by the thread; should be called under lock
+//	@tID: thread ID
+void Imitator::Scheduler::Free(thrid tID)
+{
+	if(!_busy[tID])	return;
+	_busy[tID] = false;
+	_running--;
+	_memUsed -= _held[tID];
+	_held[tID] = 0;
+	_released.notify_all();
+}
+
+// Thread-safety releases the memory taken by the thread
+//	@tID: thread ID
+void Imitator::Scheduler::Release(thrid tID)
+{
+	lock_guard<mutex> lock(_lock);
+	Free(tID);
+}
+
+// Thread-safety records measured time of the completely generated chrom's task
+//	@cID: chrom's ID
+//	@cost: chrom's model cost
+//	@time: measured time in seconds
+void Imitator::Scheduler::Done(chrid cID, float cost, float time)
+{
+	if(cost <= 0)	return;
+	lock_guard<mutex> lock(_lock);
+	auto& done = _done[cID];		// Test and Control may be measured separately
+
+	done.first += cost;
+	done.second += time;
+}
+
+// Prints the chroms distribution
+void Imitator::Scheduler::Print() const
+{
+	for(thrid i = 0; i < _queues.size(); i++) {
+		cout << SignDbg << sThread << int(i) << ":\t" << Chrom::Abbr;
+		for(const Task& t : _queues[i])
+			cout << SPACE << Chrom::Mark(t.ID) << (t.Mode == GM::eMode::Control ? "i" : strEmpty);
+		cout << "  (estimated " << setprecision(3) << _loads[i] << " s)\n";
+	}
+	if(_memLimit)
+		cout << SignDbg << "memory budget of " << Chrom::Title(true) << SepCl << (_memLimit >> 20)
+			 << " Mb; clone I/O buffer" << SepCl << (TxtFile::CloneBuffLen >> 10)
+			 << " Kb; held coverage" << SepCl << (CoverOutFile::MemLimit >> 20) << " Mb\n";
+}
+
+/************************  class Scheduler: end ************************/
+
+/************************  class Resident ************************/
+
+map<string, shared_ptr<RefSeq>> Imitator::Resident::_seqs;
+mutex	Imitator::Resident::_lock;
+bool	Imitator::Resident::On = false;
+
+// Returns kept chrom, loading it at the first request
+//	@cID: chrom ID
+//	@cSizes: chrom sizes
+//	@fill: if false then nucleotides are not loaded
+shared_ptr<RefSeq> Imitator::Resident::Seq(chrid cID, const ChromSizes& cSizes, bool fill)
+{
+	string key = cSizes.RefName(cID) + cSizes.RefExt();
+#ifdef __unix__
+	char path[PATH_MAX];
+	if (realpath(key.c_str(), path))	key = path;		// jobs may have different working directories
+#endif
+	key += char('0' + fill + 2 * RefSeq::LetGaps + 4 * RefSeq::StatGaps);
+	{
+		lock_guard<mutex> lock(_lock);
+		const auto it = _seqs.find(key);
+		if (it != _seqs.end())	return it->second;
+	}
+	// chroms are loaded concurrently; the same chrom is loaded by a single thread
+	shared_ptr<RefSeq> seq = make_shared<RefSeq>(cID, cSizes, fill);
+	lock_guard<mutex> lock(_lock);
+	return _seqs.emplace(key, seq).first->second;
+}
+
+/************************  class Resident: end ************************/
+
+// Returns loaded chrom: kept one in server mode, otherwise new one
+//	@cID: chrom ID
+//	@cSizes: chrom sizes
+//	@arena: thread's buffer keeper to place the nucleotides, or NULL to allocate own buffer
+shared_ptr<RefSeq> Imitator::LoadSeq(chrid cID, const ChromSizes& cSizes, SeqArena* arena)
+{
+	if (Resident::On)	return Resident::Seq(cID, cSizes, !Output::IsSeqFree());
+	return shared_ptr<RefSeq>(new RefSeq(cID, cSizes, !Output::IsSeqFree(), arena));
+}
+
+/************************  class Journal ************************/
+
+const char* Imitator::Journal::Ext = ".journal";
+
+// Reads records of the interrupted run if journal exists, and opens journal for appending
+//	@fName: file name without extention
+//	@key: run's arguments; journal of another arguments is refused
+Imitator::Journal::Journal(const string& fName, const string& key) : _file(NULL), _fName(fName + Ext)
+{
+	const UINT header[]{ Magic, UINT(key.length()) };
+
+	if (FS::IsFileExist(_fName.c_str())) {
+		unique_ptr<FILE, int(*)(FILE*)> file(fopen(_fName.c_str(), "rb"), fclose);
+		if (!file)	Err(Err::F_OPEN, _fName.c_str()).Throw();
+		UINT hdr[2];
+		string line;
+		if (fread(hdr, sizeof(hdr), 1, file.get()) != 1 || hdr[0] != Magic)
+			Err("wrong format of journal", _fName).Throw();
+		line.resize(hdr[1]);
+		if (hdr[1] != header[1] || fread(&line[0], 1, hdr[1], file.get()) != hdr[1] || line != key)
+			Err("journal is created with other options; remove it to start from scratch", _fName)
+			.Throw();
+		Rec rec;
+		// the last record may be truncated by interruption; its chrom is generated again
+		while (fread(&rec, sizeof(Rec), 1, file.get()) == 1)	_recs.push_back(rec);
+	}
+	// rewrite journal to drop the truncated record
+	if (!(_file = fopen(_fName.c_str(), "wb")))	Err(Err::F_OPEN, _fName.c_str()).Throw();
+	if (fwrite(header, sizeof(header), 1, _file) != 1
+	|| fwrite(key.data(), 1, key.length(), _file) != key.length()
+	|| fwrite(_recs.data(), sizeof(Rec), _recs.size(), _file) != _recs.size()
+	|| fflush(_file))
+		Err(Err::F_WRITE, _fName.c_str()).Throw();
+}
+
+// Returns record of chrom's replicate completed by the interrupted run, or NULL
+const Imitator::Journal::Rec* Imitator::Journal::Find(BYTE rep, chrid cID) const
+{
+	for (const Rec& rec : _recs)
+		if (rec.Rep == rep && rec.cID == cID)	return &rec;
+	return NULL;
+}
+
+// Returns sorted IDs of chroms completed by the interrupted run
+//	@rep: replicate
+vector<chrid> Imitator::Journal::DoneIDs(BYTE rep) const
+{
+	vector<chrid> cIDs;
+	for (const Rec& rec : _recs)
+		if (rec.Rep == rep)		cIDs.push_back(rec.cID);
+	sort(cIDs.begin(), cIDs.end());
+	return cIDs;
+}
+
+// Restores total statistics of the interrupted run
+void Imitator::Journal::Restore() const
+{
+	for (const Rec& rec : _recs)	RestoreChrom(rec);
+}
+
+// Thread-safety records completed chrom
+void Imitator::Journal::Add(const Rec& rec)
+{
+	lock_guard<mutex> lock(_lock);
+	if (fwrite(&rec, sizeof(Rec), 1, _file) != 1 || fflush(_file))
+		Err(Err::F_WRITE, _fName.c_str()).Throw();
+}
+
+// Closes and removes journal after successful run
+void Imitator::Journal::Remove()
+{
+	fclose(_file);
+	_file = NULL;
+	remove(_fName.c_str());
+}
+
+/************************  class Journal: end ************************/
+
+/************************  class Cache ************************/
+
+const char* Imitator::Cache::Ext = ".stat";
+
+// Returns FNV-1a hash of the data
+//	@data: hashed data
+//	@len: length of data in bytes
+//	@hash: initial hash value
+ULLONG Imitator::Cache::Hash(const void* data, size_t len, ULLONG hash)
+{
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ static_cast<const BYTE*>(data)[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+// Returns hash of chrom's own inputs: reference layout, template features and regions
+//	@seq: chrom's reference
+//	@hash: initial hash value
+ULLONG Imitator::Cache::ChromHash(const RefSeq& seq, ULLONG hash)
+{
+	const chrid cID = seq.ID();
+	// the generation depends on the reference layout only; nucleotides are read by rendering
+	const chrlen ref[]{ seq.Length(), seq.DefRegion().Start, seq.DefRegion().End, seq.GapLen() };
+	ULLONG key = Hash(ref, sizeof(ref), hash);
+
+	if (Templ) {
+		const auto cit = Templ->GetIter(cID);
+		if (cit != Templ->cEnd())
+			for (size_t k = 0; k < Templ->ItemsCount(cID); k++) {
+				const Featr& f = Templ->Feature(cit, chrlen(k));
+				key = Hash(&f.Start, sizeof(f.Start), key);
+				key = Hash(&f.End, sizeof(f.End), key);
+				key = Hash(&f.Value, sizeof(f.Value), key);
+			}
+	}
+	if (Wins)
+		for (const Region& win : *Wins->Find(cID))
+			key = Hash(&win, sizeof(win), key);
+	return key;
+}
+
+// Returns the common name of chrom replicate's files
+//	@rep: replicate
+//	@cID: chrom's ID
+string Imitator::Cache::ShardName(BYTE rep, chrid cID) const
+{
+	ostringstream ss;
+	ss << _path << hex << setfill('0') << setw(16) << _keys.at(ULONG(rep) << 16 | cID);
+	return ss.str();
+}
+
+// Finds the treated chrom's replicates in cache and restores their statistics.
+//	@cSizes: chrom sizes
+void Imitator::Cache::Init(const ChromSizesExt& cSizes)
+{
+	// common inputs: program version, arguments and the values set by them;
+	// the samples and cells are derived from them, so they are not hashed
+	const ULONG	values[]{ ULONG(Seq::ReadsLimit()), ULONG(FlatLen), Read::FixedLen };
+	ULLONG base = Hash(Product::Version.data(), Product::Version.length());
+	base = Hash(_args.data(), _args.length(), base);
+	base = Hash(values, sizeof(values), base);
+	// the recovery sample is derived from the inputs of all treated chroms
+	if (AutoSample < 1)
+		for (ChromSizes::cIter it = cSizes.cBegin(); it != cSizes.cEnd(); it++)
+			if (cSizes.IsTreated(it))
+				base = ChromHash(RefSeq(CID(it), cSizes, false), Hash(&CID(it), sizeof(chrid), base));
+
+	size_t cnt = 0;		// number of treated chrom's replicates
+	for (ChromSizes::cIter it = cSizes.cBegin(); it != cSizes.cEnd(); it++) {
+		if (!cSizes.IsTreated(it))	continue;
+		const RefSeq seq(CID(it), cSizes, false);
+
+		for (BYTE r = 0; r < RepCnt; r++) {
+			if (Jrnl && Jrnl->IsDone(r, CID(it)))	continue;	// records are already in the REC file
+			const ULONG rc = ULONG(r) << 16 | CID(it);
+			_keys[rc] = Key(base, r, seq);
+			cnt++;
+
+			const string name = ShardName(r, CID(it));
+			if (!FS::IsFileExist((name + RecOutFile::Ext).c_str())
+			|| (MakeControl && !FS::IsFileExist((name + "_input" + RecOutFile::Ext).c_str())))
+				continue;
+			unique_ptr<FILE, int(*)(FILE*)> file(fopen((name + Ext).c_str(), "rb"), fclose);
+			Journal::Rec rec;
+			if (!file || fread(&rec, sizeof(rec), 1, file.get()) != 1 || rec.cID != CID(it))
+				continue;
+			rec.Rep = r;
+			RestoreChrom(rec);
+			_hits.push_back(rc);
+		}
+	}
+	sort(_hits.begin(), _hits.end());
+	if (Verbose(eVerb::PAR))
+		cout << SignPar << "Cache" << SepCl << _path << SepCm
+			<< _hits.size() << " of " << cnt << SPACE << Chrom::Title(true) << " reused\n";
+}
+
+// Thread-safety remembers generated chrom's replicate to be cached
+void Imitator::Cache::Add(const Journal::Rec& rec)
+{
+	lock_guard<mutex> lock(_lock);
+	_recs.push_back(rec);
+}
+
+// Stores the generated chrom's replicates in cache,
+// and appends the found ones to the REC files of each replicate
+//	@oNames: common names of output files of each replicate
+void Imitator::Cache::Assemble(const vector<string>& oNames) const
+{
+	for (BYTE r = 0; r < oNames.size(); r++)
+		for (BYTE i = 0; i <= BYTE(MakeControl); i++) {
+			const string suffix = string(i ? "_input" : strEmpty) + RecOutFile::Ext;
+			const string recName = oNames[r] + suffix;
+			{
+				const RecInFile file(recName);
+				for (const Journal::Rec& rec : _recs)
+					if (rec.Rep == r)	file.Extract(rec.cID, ShardName(r, rec.cID) + suffix);
+			}
+			for (ULONG rc : _hits)
+				if (rc >> 16 == r)	RecInFile(ShardName(r, chrid(rc)) + suffix).AppendTo(recName);
+		}
+	// statistics are written last: the chrom's replicate is cached only with its statistics
+	for (const Journal::Rec& rec : _recs) {
+		const string name = ShardName(rec.Rep, rec.cID) + Ext;
+		FILE* file = fopen(name.c_str(), "wb");
+
+		if (!file || fwrite(&rec, sizeof(rec), 1, file) != 1 || fclose(file)) {
+			Err(Err::F_WRITE, name.c_str()).Warning();
+			remove(name.c_str());
+		}
+	}
+}
+
+/************************  class Cache: end ************************/
+
 /************************  class Imitator ************************/
 
 Imitator::GenomeSizes Imitator::gSizes;
-Imitator::Context	Imitator::GlobContext[2];	// global generation context
+vector<Imitator::Context> Imitator::GlobContext(2);	// global generation context of each replicate
 Imitator::ChromView Imitator::ChrView[] = {Gr::FG,Gr::BG};
 ULONG	Imitator::TreatedLen[] = {0,0};	// FG, BF genome treated length
+set<chrid> Imitator::RestoredIDs;		// chroms whose treated length is restored from journal or cache
 float	Imitator::AutoSample = 1;		// adjusted FG sample to stay in limit
 //readlen	Imitator::BindLen;
 short	Imitator::FlatLen = 0;		// BS edge flattening length
 a_coeff	Imitator::PCRCoeff = 0;		// user-stated amplification coefficient
 eVerb	Imitator::Verb;
 BYTE	Imitator::ThrCnt;			// actual number of threads
+size_t	Imitator::MemLimit = 0;		// memory limit in bytes, or 0 if unlimited
+BYTE	Imitator::RepCnt = 1;		// number of replicates generated in a single pass
+vector<chrid> Imitator::ShardedIDs;	// sorted IDs of chroms treated by all shards, or empty if no shards
+ULLONG	Imitator::FragsLimit;		// limit of recorded frags: the stated one, or its share in shard mode
 bool	Imitator::IsExo;
 bool	Imitator::IsMDA;
 bool	Imitator::MakeControl;		// true if control file (input) should be produced
+bool	Imitator::ChromRows = true;	// true if statistics is printed for each chrom
 bool	Imitator::UniScore;
 bool	Imitator::All;
 eMode	Imitator::TMode;			// Current task mode
 float	Imitator::SelFragAvr;		// mean length of selected fragments
 Imitator *Imitator::Imit = NULL;
+Imitator::Journal *Imitator::Jrnl = NULL;	// journal of completed chroms, or NULL
+Imitator::Cache *Imitator::Cch = NULL;		// cache of chroms, or NULL
+Imitator::Windows *Imitator::Wins = NULL;	// windows of the simulation, or NULL
 const Features *Imitator::Templ = NULL;
 
 // Prints chromosome's name
 //	@cID: chromosomes ID, or CHRID_UNDEF to print "total" instead chrom name
 //	@gm: generation mode Test|Control
+//	@rep: replicate
 //	@print: true if chromosomes name should be printed
-void Imitator::PrintChromName(chrid cID, GM::eMode gm, bool print)
+void Imitator::PrintChromName(chrid cID, GM::eMode gm, BYTE rep, bool print)
 {
 	if( Verbose(eVerb::RT) && print) {
+		if(RepCnt > 1)		cout << setw(RepMarkW()) << left << setfill(SPACE) << RepMark(rep);
 		if(MakeControl) 	cout << *GM::Title(gm) << SPACE;
 		cout << setw(ChromView::ChromNameW()) << left << setfill(SPACE)
 			 << (cID==Chrom::UnID ? sTotal : Chrom::AbbrName(cID, true)) + COLON;
@@ -685,13 +1489,14 @@ void Imitator::PrintChromName(chrid cID, GM::eMode gm, bool print)
 // Prints chromosome's name and full statistics
 //	@cID: chromosomes ID, or CHRID_UNDEF to print "total" instead chrom name
 //	@gMode: Test|Control
+//	@rep: replicate
 //	@fCnts: array of fragment's counters, for FG and BG
 //	@rgnLens: array of region's lengths to print FG|BG density
 //	@prChrName: true if chromosome's name should be printed
-void Imitator::PrintChromInfo(
-	chrid cID, GM::eMode gMode, const FragCnt fCnts[], const ULONG rgnLens[], bool prChrName)
+void Imitator::PrintChromInfo(chrid cID, GM::eMode gMode, BYTE rep,
+	const FragCnt fCnts[], const ULONG rgnLens[], bool prChrName)
 {
-	PrintChromName(cID, gMode, prChrName);
+	PrintChromName(cID, gMode, rep, prChrName);
 	if(TestMode)	
 		PrintReadInfo(Gr::FG, gMode, fCnts, rgnLens);
 	PrintReadInfo(Gr::BG, gMode, fCnts, rgnLens);
@@ -707,6 +1512,8 @@ void Imitator::PrintHeader(bool header)
 	if(header) {
 		w = 0;
 		if(Verbose(eVerb::PAR))	cout << LF;
+		if(RepCnt > 1)
+			w += PrFittedStr(sSPACE, RepMarkW());	// "r1 ", "r2 " etc.
 		if(MakeControl)
 			w += PrFittedStr(sSPACE, 2);	// "t " or "c "
 		cout << setfill(SPACE) << left;
@@ -723,16 +1530,19 @@ void Imitator::PrintHeader(bool header)
 // Prints total outcome
 void Imitator::PrintTotal()
 {
-	cout << sTotal << " recorded "; Output::PrintItemTitle();
-	if(MakeControl)		// add "test:"
-		cout << SepCl << GM::Title(GM::eMode::Test) << COLON;
-	cout << SPACE;
-	Output::PrintItemCount( GlobContext[int(GM::eMode::Test)].RecCnt() );
-	if (MakeControl) {	// add "control:"
-		cout << SepCm << GM::Title(GM::eMode::Control) << SepCl;
-		Output::PrintItemCount( GlobContext[int(GM::eMode::Control)].RecCnt() );
+	for(BYTE r = 0; r < RepCnt; r++) {
+		if(RepCnt > 1)	cout << RepMark(r) << SPACE;
+		cout << sTotal << " recorded "; Output::PrintItemTitle();
+		if(MakeControl)		// add "test:"
+			cout << SepCl << GM::Title(GM::eMode::Test) << COLON;
+		cout << SPACE;
+		Output::PrintItemCount( RepContext(r, GM::eMode::Test).RecCnt() );
+		if (MakeControl) {	// add "control:"
+			cout << SepCm << GM::Title(GM::eMode::Control) << SepCl;
+			Output::PrintItemCount( RepContext(r, GM::eMode::Control).RecCnt() );
+		}
+		cout << endl;		// flash cout buffer
 	}
-	cout << endl;		// flash cout buffer
 }
 
 // Print amplification info
@@ -749,12 +1559,34 @@ void Imitator::PrintAmpl(const char* signOut)
 	cout << LF;
 }
 
+// Adds statistics of generated chrom's replicate to the totals
+//	@rec: chrom replicate's record
+void Imitator::RestoreChrom(const Journal::Rec& rec)
+{
+	FragCnts cnts = rec.Cnts;
+
+	for (BYTE m = 0; m < 2; m++) {
+		cnts.SetGMode(GM::eMode(m));
+		for (BYTE g = 0; g < Gr::Cnt; g++)
+			RepContext(rec.Rep, GM::eMode(m)).fCnts[g].Add(cnts[g]);
+	}
+	// the length is counted once per chrom, whichever of its replicates is restored first;
+	// restoring is completed before the generation, so the set is not changed concurrently
+	if (RestoredIDs.insert(rec.cID).second) {		// the same as IncrementTotalLength()
+		TreatedLen[Gr::FG] += rec.EnrRegLen;
+		TreatedLen[Gr::BG] += rec.Sizes.DefLength() - rec.EnrRegLen;
+		if (Verbose(eVerb::PAR))	gSizes.IncrSizes(rec.Sizes);
+	}
+}
+
 // Increments grounds total length.
 void Imitator::IncrementTotalLength(const RefSeq& seq, chrlen enrRgnLen)
 {
+	const GenomeSizes sizes(seq);
+
 	if(enrRgnLen)	InterlockedExchangeAdd(&(TreatedLen[Gr::FG]), enrRgnLen);
-	InterlockedExchangeAdd(&(TreatedLen[Gr::BG]), seq.DefRegion().Length() - enrRgnLen);
-	if(Verbose(eVerb::PAR))	gSizes.IncrSizes(seq);
+	InterlockedExchangeAdd(&(TreatedLen[Gr::BG]), sizes.DefLength() - enrRgnLen);
+	if(Verbose(eVerb::PAR))	gSizes.IncrSizes(sizes);
 }
 
 // Initializes static values
@@ -771,14 +1603,27 @@ void	Imitator::Init(
 	//bool	uniScore,			// true if uniform template score is assigned
 	//readlen bindLen,
 	//const pairVal& flattens
-	fraglen	unstBindLen			// unstable binding length
+	fraglen	unstBindLen,		// unstable binding length
+	BYTE	repCnt				// number of replicates
 ) {
 	TMode = tmode;
+	// reset the totals of the previous run in the same process
+	GlobContext.assign(2 * (RepCnt = repCnt), Context());
+	TreatedLen[Gr::FG] = TreatedLen[Gr::BG] = 0;
+	RestoredIDs.clear();
+	Chrom::Reset();			// user-defined chrom and IDs discipline are set by the reference
+	gSizes = GenomeSizes();
+	AutoSample = 1;
+	ShardedIDs.clear();
+	Jrnl = NULL;
+	Cch = NULL;
+	Wins = NULL;
 	MakeControl = TestMode ? input : false;
 	GlobContext[int(GM::eMode::Test)].CellCnt = cellsCnt;
 	IsExo = isExo;
 	IsMDA = isMDA;
 	PCRCoeff = amplCoeff;	// the actual ChromCutter ampl coeff will be set in Sample()
+	ChromCutter::SetAmpl();
 	ChromCutter::FragDistr::Init();
 	Verb = eVerb(verb);
 	All = (tmode == CONTROL) || allBg;
@@ -804,11 +1649,12 @@ void Imitator::Execute(Features* templ)
 	// print statistics
 	if(Verb == eVerb::RES)		PrintTotal();
 	else if( Verbose(eVerb::RT) )	{
-		if(_cSizes.TreatedCount() > 1) {	// print summary test statistics?
-			PrintChromInfo(Chrom::UnID, GM::eMode::Test, GlobContext[int(GM::eMode::Test)].fCnts, TreatedLen);
-			if(Verbose(eVerb::PAR))	ChrView[Gr::BG].PrintGaps(gSizes);	// ground doesn't matter
-			cout << LF;
-		}
+		if(_cSizes.TreatedCount() > 1)	// print summary test statistics?
+			for(BYTE r = 0; r < RepCnt; r++) {
+				PrintChromInfo(Chrom::UnID, GM::eMode::Test, r, RepContext(r, GM::eMode::Test).fCnts, TreatedLen);
+				if(Verbose(eVerb::PAR))	ChrView[Gr::BG].PrintGaps(gSizes);	// ground doesn't matter
+				cout << LF;
+			}
 		if(TestMode)	PrintTotal();
 	}
 }
@@ -818,18 +1664,24 @@ void Imitator::Execute(Features* templ)
 // Cuts genome into fragments and generate output
 void Imitator::CutGenome	()
 {
-	effPartition cSets(_cSizes, thrid(ThrCnt));
+	// limit of chroms printed by rows; scaffold-level assemblies are printed by total only
+	static const chrid MaxChromRowsCnt = 256;
 	
-	if( ThrCnt>1 && Verbose(eVerb::DBG))	cSets.Print();
 	if(FlatLen < 0)		FlatLen = -FlatLen;
+	ChromRows = _cSizes.TreatedCount() <= MaxChromRowsCnt;
+	if(ChromRows)	ChromView::SetChromNameW(_cSizes);
 	SetSample();
+	Scheduler sched(_cSizes, thrid(ThrCnt), _oFiles);	// after samples are set: cells count is known
+	if( ThrCnt>1 && Verbose(eVerb::DBG))	sched.Print();
+	if(Jrnl)	Jrnl->Restore();
+	if(Cch)		Cch->Init(_cSizes);
 	PrintHeader(true);
 
 	bool master = true;
 	vector<thread> threads;
 	threads.reserve(ThrCnt);
 	for (BYTE i = 0; i < ThrCnt; master = false, i++)
-		threads.emplace_back(&Imitator::CutChrom, this, cSets[i], master);
+		threads.emplace_back(&Imitator::CutChrom, this, ref(sched), thrid(i), master);
 	for (thread& t : threads)	t.join();
 
 	PrintHeader(false);
@@ -863,12 +1715,13 @@ ULLONG Imitator::CutForSample(Average& genFrAvr, FragLenStat* fLenStat)
 	ChromCutter cCutter(this, &genFrAvr, false);
 	const RefSeq seq(_cSizes[0]);
 	const chrlen cLen = seq.End();		// chrom defined 'end' position
+	const Featr chrom(seq.DefRegion(), 1);	// whole chrom as a feature with full score
 	float scores[]{ 1,1 };
 	
 	// generate statistics based on first chrom; Reads are not recorded
 	GlobContext[int(GM::eMode::Test)].SetSample(1.0);
 	for(int i=0; i<2; pos=0, i++)
-		cCutter.CutChrom(cLen, pos, seq.DefRegion(), scores, false, fLenStat);
+		cCutter.CutChrom(cLen, pos, chrom, scores, false, fLenStat);
 	GlobContext[int(GM::eMode::Test)].ClearFragCounters();
 	return cCutter.RecFgFragCnt();
 }
@@ -927,9 +1780,17 @@ void Imitator::SetSample()
 		if( !(GlobContext[int(GM::eMode::Test)].Sample[Gr::BG] *= SAMPLE_BG()/100) )	All = false;
 	if(MakeControl)	// can be true only in TEST task mode
 		GlobContext[int(GM::eMode::Control)].SetControlSample( GlobContext[int(GM::eMode::Test)].GetExactBGCellCnt() );
+	// replicates share the cells and samples of the first one
+	for(BYTE r = 1; r < RepCnt; r++)
+		RepContext(r, GM::eMode::Test) = GlobContext[int(GM::eMode::Test)],
+		RepContext(r, GM::eMode::Control) = GlobContext[int(GM::eMode::Control)];
 
 	// *** Determine the total possible numbers of recorded reads
+	// In shard mode the sample is estimated by chroms of all shards to be the same in each of them
 	ULLONG	totalCnt = 0;		// total number of recorded reads
+	ULLONG	ownCnt = 0;			// number of recorded reads by treated chroms
+	ULLONG	ownBgCnt = 0;		// number of recorded background reads by treated chroms
+	ULLONG	totalLen = 0, ownLen = 0;	// total and treated chroms length: shard share if no reads estimated
 	ULONG	maxCnt[] = {0,0};
 	float	maxDens[] = {0,0};
 	chrlen	enRgnLen;		// length of enriched regions
@@ -939,25 +1800,39 @@ void Imitator::SetSample()
 		(IsMDA ? avr.MdaLen : avr.RecLen);
 
 	for(ChromSizes::cIter it=_cSizes.cBegin(); it!=_cSizes.cEnd(); it++) {
-		if( !_cSizes.IsTreated(it) )	continue;
+		const bool own = _cSizes.IsTreated(it);
+		if( !own && !binary_search(ShardedIDs.begin(), ShardedIDs.end(), CID(it)) )	continue;
+		ULLONG cnt = 0;
 		// count is estimated according to diploid (numerical) sign,
 		//	but density not, because basic length is single!
+		const chrlen defLen = Wins ?		// length of the treated part
+			Wins->Length(CID(it), Region(0, _cSizes[CID(it)])) : _cSizes.DefEffLength(it);
 		if( Templ && Templ->FindChrom(CID(it)) ) {
-			enRgnLen = Templ->EnrRegnLength(CID(it), 0, SelFragAvr);
-			totalCnt += GetReadsCnt(Gr::FG, enRgnLen, countFactor, 0, maxCnt, maxDens);
+			enRgnLen = Wins ? Wins->Length(CID(it), *Templ) : Templ->EnrRegnLength(CID(it), 0, SelFragAvr);
+			cnt = GetReadsCnt(Gr::FG, enRgnLen, countFactor, 0, maxCnt, maxDens);
 		}
 		else	enRgnLen = 0;
-		totalCnt += GetReadsCnt(Gr::BG,	_cSizes.DefEffLength(it) - enRgnLen,
+		const ULLONG bgCnt = GetReadsCnt(Gr::BG,	defLen - enRgnLen,
 			countFactor, Chrom::IsAutosome(CID(it)), maxCnt, maxDens);
+		cnt += bgCnt;
+		totalCnt += cnt;
+		totalLen += defLen;
+		if(own)	ownCnt += cnt, ownBgCnt += bgCnt, ownLen += defLen;
 	}
 	//if (IsMDA)	totalCnt += totalCnt/5;	// empirical coefficient 1.2: right for small read cnt, but failed for big one
 	if(PCRCoeff) {
 		ChromCutter::SetAmpl();
 		totalCnt *= ULLONG(pow(2.f, int(PCRCoeff)));
+		ownCnt *= ULLONG(pow(2.f, int(PCRCoeff)));
+		ownBgCnt *= ULLONG(pow(2.f, int(PCRCoeff)));
 	}
 	// *** Estimate adjusted Sample
 	if(totalCnt > Seq::ReadsLimit())
 		AutoSample = Seq::ReadsLimit() / totalCnt;
+	// *** Prorate Reads limit to the shard
+	FragsLimit = Seq::FragsLimit();
+	if(ShardedIDs.size())
+		FragsLimit = ULLONG(FragsLimit * (totalCnt ? double(ownCnt) / totalCnt : double(ownLen) / totalLen));
 	// *** print debug info
 	if(Verbose(eVerb::PAR)) {
 		cout << SignPar << "Actual fragments size" << SepCl
@@ -975,6 +1850,10 @@ void Imitator::SetSample()
 	if(AutoSample < 1 && Verbose(eVerb::RES))
 		cout << "Added recovery sample = " << setprecision(3) << (AutoSample * 100)
 			<< "% due to reads limit of " << Seq::ReadsLimit() << endl;
+	// *** Preallocate Read output files;
+	// Control cells are set by Test background, which is sampled over the whole chroms
+	for(const auto& o : _oFiles)
+		o->Reserve(ULLONG(ownCnt * AutoSample), MakeControl ? ULLONG(ownBgCnt * AutoSample) : 0);
 
 	// *** set Reads statistics params
 	if(TestMode)	
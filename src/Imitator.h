@@ -9,6 +9,9 @@ Provides chip-seq imitation functionality
 #pragma once
 #include "DataOutFile.h"
 #include "effPartition.h"
+#include <deque>
+#include <set>
+#include <condition_variable>
 //#include <math.h>       /* log */
 
 using namespace std;
@@ -163,6 +166,13 @@ class Imitator
 
 		// Thread-savely adds value to number of selected frags
 		inline void SelAddSaved(ULLONG val) { (this->*pSelAddSaved)(val); }
+
+		// Adds all numbers of another counter
+		inline void Add(const FragCnt& fCnt) {
+			sel += fCnt.sel;
+			rec[0] += fCnt.rec[0];
+			rec[1] += fCnt.rec[1];
+		}
 	};
 
 	// 'FragCnts' keeps statistics for selected and recorded Reads, for both Test and MakeControl modes
@@ -182,6 +192,13 @@ class Imitator
 
 		// Clears all fragment counters
 		inline void Clear() { memset(fCnts, 0, 2*Gr::Cnt*sizeof(FragCnt)); }
+
+		// Copies fragment counters of the stated mode
+		//	@cnts: copied counters
+		//	@mode: copied mode
+		inline void Assign(const FragCnts& cnts, GM::eMode mode) {
+			memcpy(fCnts[int(mode)], cnts.fCnts[int(mode)], Gr::Cnt*sizeof(FragCnt));
+		}
 	};
 
 	// 'GenomeSizes' keeps total, defined and gaps length in purpose to print average gap statistics
@@ -195,18 +212,30 @@ class Imitator
 	public:
 		inline GenomeSizes() { Total = Defined = Gaps = 0; }
 
-		// constructor by single chrom
+		// constructor by single chrom; in windows mode the windows are taken as the whole chrom
 		inline GenomeSizes(const RefSeq& seq) : 
-			Total(seq.Length()), Defined(seq.DefRegion().Length()), Gaps(seq.GapLen()) {}
+			Total(seq.Length()), Defined(seq.DefRegion().Length()), Gaps(seq.GapLen())
+		{
+			if(Wins)	Total = Wins->Length(seq.ID(), Region(0, seq.Length())),
+				Defined = Wins->Length(seq.ID(), seq.DefRegion()), Gaps = 0;
+		}
+
+		// Returns sum if chroms defined (effective) length
+		inline ULONG DefLength() const { return Defined; }
+
+		// Thread-safety increment sizes by another sizes
+		void IncrSizes(const GenomeSizes& sizes);
 
 		// Thread-safety increment sizes by RefSeq
-		void IncrSizes(const RefSeq& seq);
+		inline void IncrSizes(const RefSeq& seq) { IncrSizes(GenomeSizes(seq)); }
 
 		inline float GapsInPers() const { return 100.f * Gaps / Total; }
 
 		inline float UndefInPers() const { return 100.f * (Total - Defined) / Total; }
 	};
 
+	class Scheduler;
+
 	//public:
 	// 'ChromCutter' encapsulates thread context and methods to cut chromosomes.
 	class ChromCutter
@@ -297,15 +326,22 @@ class Imitator
 		
 		bool		_master;	// if true then this instance is master
 		GM::eMode	_gMode;		// generating mode: 0 - Test, 1 - Control
-		Output*		_output;	// partial output files
+		BYTE		_rep = 0;	// current replicate
+		Output*		_output;	// current replicate's partial output files
+		vector<Output*>	_outputs;	// partial output files of each replicate
 		FragCnts	_fragCnt;	// numbers of selected/recorded fragments for FG & BG, for both Teat & Input
 		FragDistr	_fragDistr;	// normal & lognormal random number generator
 		MDA			_ampl;
+		Region		_win;		// current window: fragments before it are skipped, after it are not cut
+		SeqArena	_arena;		// reusable buffer of the chrom sequences
 		const ChromSizesExt& _cSizes;	// reference genome
 
 		// Sets global mode
 		void SetGMode(GM::eMode gmode);
 
+		// Sets current replicate
+		inline void SetReplicate(BYTE rep) { _output = _outputs[_rep = rep]; }
+
 		// Increments counters of local and total recorded fragments thread-safely
 		//	@g: ground
 		//	@primer: true if increment derived (amplified) frag's counter
@@ -352,7 +388,7 @@ class Imitator
 		//	@master: if true then this instance is master
 		ChromCutter(const Imitator* imitator, Average* avr, bool master);
 		
-		inline ~ChromCutter () { if(!_master)	delete _output; }
+		inline ~ChromCutter () { if(!_master)	for(Output* o : _outputs)	delete o; }
 
 		// Returns number of FG recorded frags
 		inline ULLONG RecFgFragCnt() const { return _fragCnt[Gr::FG].RecCnt(); }
@@ -360,9 +396,15 @@ class Imitator
 		// Set mode, print chrom name, start timer, return number of cells
 		ULONG PrepareCutting(GM::eMode gm, chrid cID, Timer& timer);
 
-		// Treats chromosomes given for current thread
-		//	@cSubset: pointer to ChrSubset - set of chrom IDs treated in this thread
-		void Execute(const effPartition::Subset& cSubset);
+		// Sets current window and moves the fragment start to the window's margin if it is behind
+		//	@win: window
+		//	@fStart: fragment start position
+		void SetWindow(const Region& win, chrlen& fStart);
+
+		// Treats chromosomes taken from the scheduler
+		//	@sched: chroms scheduler
+		//	@tID: thread ID
+		void Execute(Scheduler& sched, thrid tID);
 		
 		// Cuts chromosome until reaching end position of current treated feature
 		//	@cLen: chromosome's 'end' position
@@ -413,6 +455,7 @@ class Imitator
 		static const char* tTime;			// title of time output
 
 		static BYTE GapsWexcl;		// width of excluded gaps field
+		static BYTE MarkW;			// width of chrom's mark field
 
 		// Prints empty margin
 		//	@width: margin width
@@ -428,9 +471,13 @@ class Imitator
 		// Gets the maximum length of chrom name field with blank after
 		static const BYTE ChromNameW() { 
 			// 2 = 1 for blank inside chrom name + 1 for COLON
-			return Chrom::MaxAbbrNameLength + 2 + margC_;
+			return BYTE(strlen(Chrom::Abbr)) + MarkW + 2 + margC_;
 		}
 
+		// Sets the width of chrom's mark field by the longest treated chrom's mark
+		//	@cSizes: chrom sizes
+		static void SetChromNameW(const ChromSizesExt& cSizes);
+
 		// returns ground title width or 0 if not TEST mode
 		static BYTE GrTitleW() { return BYTE(TestMode * (Gr::TitleLength + strlen(SepCl))); }
 
@@ -473,6 +520,9 @@ class Imitator
 		// Gets total number of recorded frags
 		inline ULLONG RecCnt()	const{ return fCnts[Gr::FG].RecCnt() + fCnts[Gr::BG].RecCnt(); }
 
+		// Returns true if Reads limit is achieved
+		inline bool IsLimited() const { return RecCnt() >= FragsLimit; }
+
 		// Sets sample for both grounds
 		inline void SetSample(float sample) { Sample[Gr::FG] = Sample[Gr::BG] = sample; }
 
@@ -500,18 +550,20 @@ class Imitator
 	static GenomeSizes gSizes;		// genome total sizes; needed to define average % of gaps, excl gaps
 	static ChromView ChrView[];		// FG, BF chrom views
 	static ULONG	TreatedLen[];	// FG, BF genome treated length; needed to define total density
-	static Context	GlobContext[];	// TM, CM global generation context
+	static set<chrid> RestoredIDs;	// chroms whose treated length is restored from journal or cache
+	static vector<Context> GlobContext;	// TM, CM global generation context of each replicate
 	static float	AutoSample;		// adjusted FG sample to stay in limit
 	static float	SelFragAvr;		// mean length of selected fragments
 	static a_coeff	PCRCoeff;		// user-stated amplification coefficient
 	static eVerb	Verb;				// verbose level
 	static bool	MakeControl;		// true if control file (input) should be produced
+	static bool	ChromRows;			// true if statistics is printed for each chrom
 	static Imitator	*Imit;			// singletone instance: to call threads only
 	static const Features *Templ;	// template features or NULL (control mode)
 	//static readlen	BindLen;	// binding length
 
 	const ChromSizesExt& _cSizes;	// ref genome library
-	Output& _oFile;				// output file
+	const vector<unique_ptr<Output>>& _oFiles;	// output files of each replicate
 
 	// Returns stated count of cells
 	//	@gm: generated mode
@@ -533,11 +585,24 @@ class Imitator
 	//	@g: ground 
 	inline static float Sample(GM::eMode gm, Gr::eType g) { return GlobContext[int(gm)].Sample[g]; }
 
+	// Returns replicate's global generation context
+	//	@rep: replicate
+	//	@gm: generated mode
+	inline static Context& RepContext(BYTE rep, GM::eMode gm) { return GlobContext[2 * rep + int(gm)]; }
+
+	// Returns replicate's mark
+	//	@rep: replicate
+	inline static string RepMark(BYTE rep) { return 'r' + to_string(rep + 1); }
+
+	// Returns width of replicate's mark field with blank after
+	inline static BYTE RepMarkW() { return BYTE(RepMark(RepCnt - 1).length() + 1); }
+
 	// Prints chromosome's name
 	//	@cID: chromosomes ID, or CHRID_UNDEF to print "total" instead chrom name
 	//	@gm: generation mode Test|Control
+	//	@rep: replicate
 	//	@print: true if chromosomes name should be printed
-	static void PrintChromName(chrid cID, GM::eMode gm, bool print);
+	static void PrintChromName(chrid cID, GM::eMode gm, BYTE rep, bool print);
 
 	inline static void PrintReadInfo(
 		Gr::eType gr, GM::eMode gMode, const FragCnt fCnts[], const ULONG rgnLens[])
@@ -546,10 +611,11 @@ class Imitator
 	// Prints chromosome's name and full statistics
 	//	@cID: chromosomes ID, or CHRID_UNDEF to print "total" instead chrom name
 	//	@gMode: Test|Control
+	//	@rep: replicate
 	//	@fCnts: array of fragment's counters, for FG and BG
 	//	@rgnLens: array of region's lengths to print FG|BG density
 	//	@prChrName: true if chromosome's name should be printed
-	static void PrintChromInfo(chrid cID, GM::eMode gMode,
+	static void PrintChromInfo(chrid cID, GM::eMode gMode, BYTE rep,
 		const FragCnt fCnts[], const ULONG rgnLens[], bool prChrName=true);
 
 	// Prints header (FG and BG, or single) and solid line
@@ -596,10 +662,14 @@ class Imitator
 	void	CutGenome	();
 	
 	// Cuts genome into fragments and generate output
-	//	@arg: pointer to ChrSubset - set of chrom IDs treated in this thread
+	//	@sched: chroms scheduler
+	//	@tID: thread ID
 	//	@master: if true then this instance it master
-	inline void CutChrom(const effPartition::Subset& arg, bool master)
-	{ ChromCutter(this, NULL, master).Execute(arg); }
+	inline void CutChrom(Scheduler& sched, thrid tID, bool master)
+	{
+		Affinity::Pin(tID);		// before the thread's buffers are allocated: they are first-touched on its node
+		ChromCutter(this, NULL, master).Execute(sched, tID);
+	}
 
 	// Imitates cutting chromosome to reach statistics
 	//	return: estimated total number of Reads
@@ -610,9 +680,348 @@ class Imitator
 	// and to prorate number of written reads for each chromosome depending on reads limit.
 	void SetSample	();
 
+	// 'Scheduler' distributes the treated chroms among the threads dynamically.
+	// Chroms are ordered by the estimated cost and dealt to the threads queues, the largest first.
+	// Each thread takes the most expensive chrom from its own queue, and when the queue is empty,
+	// steals the cheapest one from the most loaded queue.
+	// The cost model is refined by the timing profile of the previous runs kept in the service folder.
+	// If the memory limit is set, a chrom is taken only if its estimated footprint fits into the budget;
+	// otherwise the thread takes the next fitting one or waits for the memory to be released.
+	class Scheduler
+	{
+		struct Task {
+			chrid	ID;		// chrom's ID
+			GM::eMode Mode;	// Test, or Control when it is treated as a separate task
+			float	Cost;	// model cost
+			float	Time;	// estimated time in seconds
+			size_t	Mem;	// estimated memory footprint in bytes
+		};
+
+		static const char* FName;		// timing profile file name
+		static const float FtrCost;		// cost of one feature per cell, in base pairs
+		static const float FmtCost;		// relative cost of one output format
+
+		// chrom's Test and Control tasks treated concurrently
+		struct Pair {
+			weak_ptr<RefSeq> Seq;	// sequence shared by the tasks while any of them is treated
+			vector<FragCnts> Cnts;	// counters of the first completed task of each replicate
+			vector<bool>	Done;	// true for the replicate completed by the first task
+			vector<bool>	Limited;// true for the replicate whose Test is cut by the Reads limit
+			mutex	Lock;
+		};
+
+		const ChromSizesExt& _cSizes;
+		bool			_split;			// true if Test and Control are separate tasks
+		map<chrid, Pair> _pairs;		// Test and Control tasks of each chrom, if they are split
+		string			_fName;			// timing profile file name, or empty if it is not kept
+		vector<deque<Task>> _queues;	// tasks of each thread
+		vector<float>	_loads;			// remaining estimated time of each queue
+		map<chrid, float> _rates;		// chrom's time per cost unit, in nanoseconds
+		map<chrid, pair<float, float>> _done;	// completed chrom's cost and measured time
+		size_t	_memLimit = 0;			// memory budget of the chroms in bytes, or 0 if unlimited
+		size_t	_memUsed = 0;			// memory taken by the treated chroms
+		vector<size_t>	_held;			// memory taken by the chrom treated by each thread
+		vector<bool>	_busy;			// true for the thread treating a chrom
+		thrid	_running = 0;			// number of threads treating a chrom
+		vector<unique_ptr<SeqArena>> _arenas;	// buffer keepers of the shared sequences
+		vector<SeqArena*> _freeArenas;	// buffer keepers not taken by any shared sequence
+		mutex	_lock;
+		condition_variable	_released;	// signals memory release
+
+		// Returns model cost of chrom's generation in the stated mode
+		//	@cSizes: chrom sizes
+		//	@it: chrom's iterator
+		//	@gm: generation mode
+		static float Cost(const ChromSizesExt& cSizes, ChromSizes::cIter it, GM::eMode gm);
+
+		// Returns estimated memory footprint of chrom's generation in bytes
+		//	@cSizes: chrom sizes
+		//	@it: chrom's iterator
+		//	@oFiles: output files of each replicate
+		static size_t Footprint(
+			const ChromSizesExt& cSizes, ChromSizes::cIter it, const vector<unique_ptr<Output>>& oFiles);
+
+		// Sets the memory budget of the chroms, reducing I/O buffers and coverage held for output to fit the limit
+		//	@thrCnt: number of threads
+		//	@oFiles: output files of each replicate
+		void SetBudget(thrid thrCnt, const vector<unique_ptr<Output>>& oFiles);
+
+		// Reads timing profile
+		void Load();
+
+		// Takes the first chrom fitting into the memory budget: from the front of the own queue,
+		// then from the back of the other queues, the most loaded first
+		//	@tID: thread ID
+		//	@task: taken chrom
+		//	return: false if there is no fitting chrom
+		bool Take(thrid tID, Task& task);
+
+		// Releases the memory taken by the thread; should be called under lock
+		//	@tID: thread ID
+		void Free(thrid tID);
+
+	public:
+		// Creates instance and distributes treated chroms among the threads
+		//	@cSizes: chrom sizes
+		//	@thrCnt: number of threads
+		//	@oFiles: output files of each replicate
+		Scheduler(const ChromSizesExt& cSizes, thrid thrCnt, const vector<unique_ptr<Output>>& oFiles);
+
+		// Writes refined timing profile
+		~Scheduler();
+
+		// Returns true if Test and Control are generated by separate tasks
+		inline bool IsSplit() const { return _split; }
+
+		// Takes the next chrom to treat, releasing the previous one;
+		// waits if there are no chroms fitting into the memory budget
+		//	@tID: thread ID
+		//	@cID: taken chrom's ID
+		//	@gm: taken task's mode; Test task includes Control if they are not split
+		//	@cost: taken chrom's model cost
+		//	return: false if there are no more chroms
+		bool Next(thrid tID, chrid& cID, GM::eMode& gm, float& cost);
+
+		// Thread-safety returns chrom's sequence shared by its Test and Control tasks,
+		// loaded by the first of them.
+		// The buffer is kept by the pooled arena, which is returned to the pool when both tasks release it,
+		// so the buffer is reused by the next shared chroms, but never by the one in use.
+		//	@cID: chrom's ID
+		shared_ptr<RefSeq> Seq(chrid cID);
+
+		// Thread-safety joins the counters of the chrom's replicate generated by its Test and Control tasks
+		//	@cID: chrom's ID
+		//	@rep: replicate
+		//	@gm: completed task's mode
+		//	@cnts: completed task's counters; on return the joined ones if the other task is completed
+		//	@limited: true if Test is cut by the Reads limit; on return the same for the joined tasks
+		//	return: true if the other task is completed as well
+		bool Join(chrid cID, BYTE rep, GM::eMode gm, FragCnts& cnts, bool& limited);
+
+		// Thread-safety releases the memory taken by the thread
+		//	@tID: thread ID
+		void Release(thrid tID);
+
+		// Thread-safety records measured time of the completely generated chrom's task
+		//	@cID: chrom's ID
+		//	@cost: chrom's model cost
+		//	@time: measured time in seconds
+		void Done(chrid cID, float cost, float time);
+
+		// Prints the chroms distribution
+		void Print() const;
+	};
+
 public:
+	// 'Journal' keeps the completed chroms of each replicate with their statistics,
+	// in purpose to resume an interrupted run
+	class Journal
+	{
+	public:
+		// completed chrom's record
+		struct Rec {
+			BYTE	Rep;			// replicate
+			chrid	cID;			// chrom's ID
+			chrlen	EnrRegLen;		// length of enriched regions
+			GenomeSizes	Sizes;		// chrom's sizes
+			FragCnts	Cnts;		// numbers of selected/recorded fragments
+		};
+
+	private:
+		static const UINT Magic = 0x314E524A;	// 'JRN1' signature
+
+		FILE*	_file;			// appended file
+		const string _fName;	// file name
+		vector<Rec>	_recs;		// records of the interrupted run
+		mutex	_lock;
+
+	public:
+		static const char* Ext;	// file extention
+
+		// Reads records of the interrupted run if journal exists, and opens journal for appending
+		//	@fName: file name without extention
+		//	@key: run's arguments; journal of another arguments is refused
+		Journal(const string& fName, const string& key);
+
+		~Journal() { if (_file)	fclose(_file); }
+
+		// Returns file name
+		inline const string& FileName() const { return _fName; }
+
+		// Returns number of replicate's chroms completed by the interrupted run
+		inline size_t Count() const { return _recs.size(); }
+
+		// Returns true if chrom's replicate is completed by the interrupted run
+		inline bool IsDone(BYTE rep, chrid cID) const { return Find(rep, cID); }
+
+		// Returns record of chrom's replicate completed by the interrupted run, or NULL
+		const Rec* Find(BYTE rep, chrid cID) const;
+
+		// Returns sorted IDs of chroms completed by the interrupted run
+		//	@rep: replicate
+		vector<chrid> DoneIDs(BYTE rep) const;
+
+		// Restores total statistics of the interrupted run
+		void Restore() const;
+
+		// Thread-safety records completed chrom
+		void Add(const Rec& rec);
+
+		// Closes and removes journal after successful run
+		void Remove();
+	};
+
+	// 'Cache' keeps records and statistics of the generated chrom's replicates in the folder,
+	// under the key hashed from all the inputs affecting the chrom's generation,
+	// in purpose to reuse them in the next runs instead of generation
+	class Cache
+	{
+		const string	_path;		// cache folder with slash
+		const string	_args;		// run's arguments affecting generation
+		map<ULONG, ULLONG>	_keys;	// keys of chrom's replicates: rep << 16 | cID -> key
+		vector<ULONG>	_hits;		// sorted chrom's replicates found in cache
+		vector<Journal::Rec> _recs;	// generated chrom's replicates to be cached
+		mutex	_lock;
+
+		// Returns FNV-1a hash of the data
+		//	@data: hashed data
+		//	@len: length of data in bytes
+		//	@hash: initial hash value
+		static ULLONG Hash(const void* data, size_t len, ULLONG hash = 0xcbf29ce484222325ULL);
+
+		// Returns hash of chrom's own inputs: reference layout, template features and regions
+		//	@seq: chrom's reference
+		//	@hash: initial hash value
+		static ULLONG ChromHash(const RefSeq& seq, ULLONG hash);
+
+		// Returns the key of chrom's replicate
+		//	@base: hash of the common inputs
+		//	@rep: replicate
+		//	@seq: chrom's reference
+		static ULLONG Key(ULLONG base, BYTE rep, const RefSeq& seq) {
+			const chrid cID = seq.ID();
+			return ChromHash(seq, Hash(&cID, sizeof(cID), Hash(&rep, sizeof(rep), base)));
+		}
+
+		// Returns the common name of chrom replicate's files
+		//	@rep: replicate
+		//	@cID: chrom's ID
+		string ShardName(BYTE rep, chrid cID) const;
+
+	public:
+		static const char* Ext;	// statistics file extention
+
+		// Creates instance
+		//	@dir: existing cache folder
+		//	@args: run's arguments affecting generation
+		Cache(const char* dir, const string& args) : _path(FS::MakePath(dir)), _args(args) {}
+
+		// Finds the treated chrom's replicates in cache and restores their statistics.
+		// Should be called after the samples are set.
+		//	@cSizes: chrom sizes
+		void Init(const ChromSizesExt& cSizes);
+
+		// Returns true if chrom's replicate is found in cache
+		inline bool IsHit(BYTE rep, chrid cID) const {
+			return binary_search(_hits.begin(), _hits.end(), ULONG(rep) << 16 | cID);
+		}
+
+		// Thread-safety remembers generated chrom's replicate to be cached
+		void Add(const Journal::Rec& rec);
+
+		// Stores the generated chrom's replicates in cache,
+		// and appends the found ones to the REC files of each replicate
+		//	@oNames: common names of output files of each replicate
+		void Assemble(const vector<string>& oNames) const;
+	};
+
+	// 'Windows' keeps the chrom's regions to which the simulation is restricted.
+	// Each window is cut starting from the margin upstream of it,
+	// so that the fragments boundaries inside the window are distributed as in the whole chrom.
+	class Windows : map<chrid, vector<Region>>
+	{
+		// Returns total length of the chrom's windows overlapping the region
+		//	@wins: sorted chrom's windows
+		//	@rgn: tested region
+		static chrlen Length(const vector<Region>& wins, const Region& rgn);
+
+	public:
+		// Returns length of the margin upstream of each window
+		static chrlen Margin();
+
+		// Adds window
+		//	@cID: chrom's ID
+		//	@rgn: window
+		inline void Add(chrid cID, const Region& rgn) { (*this)[cID].push_back(rgn); }
+
+		// Sorts windows and joins the overlapping ones
+		void Normalize();
+
+		// Returns count of windows
+		size_t Count() const;
+
+		// Returns sorted IDs of chroms with windows
+		vector<chrid> ChromIDs() const;
+
+		// Returns chrom's windows, or NULL if there are none
+		//	@cID: chrom's ID
+		const vector<Region>* Find(chrid cID) const;
+
+		// Returns total length of the chrom's windows overlapping the region
+		//	@cID: chrom's ID
+		//	@rgn: tested region
+		chrlen Length(chrid cID, const Region& rgn) const;
+
+		// Returns total length of the chrom's features inside the windows
+		//	@cID: chrom's ID
+		//	@ftrs: features
+		chrlen Length(chrid cID, const Features& ftrs) const;
+	};
+
+	static Journal*	Jrnl;		// journal of completed chroms, or NULL
+	static Cache*	Cch;		// cache of chroms, or NULL
+	static Windows*	Wins;		// windows of the simulation, or NULL if chroms are treated entirely
+
+	// Adds statistics of generated chrom's replicate to the totals
+	//	@rec: chrom replicate's record
+	static void RestoreChrom(const Journal::Rec& rec);
+
+	// Returns true if chrom's replicate should not be generated
+	inline static bool IsSkipped(BYTE rep, chrid cID) {
+		return (Jrnl && Jrnl->IsDone(rep, cID)) || (Cch && Cch->IsHit(rep, cID));
+	}
+
+	// 'Resident' keeps the loaded chroms between the runs in the same process (server mode)
+	class Resident
+	{
+		static map<string, shared_ptr<RefSeq>> _seqs;	// kept chroms by FA file name and loading mode
+		static mutex _lock;
+
+	public:
+		static bool	On;		// true if the loaded chroms are kept
+
+		// Returns kept chrom, loading it at the first request
+		//	@cID: chrom ID
+		//	@cSizes: chrom sizes
+		//	@fill: if false then nucleotides are not loaded
+		static shared_ptr<RefSeq> Seq(chrid cID, const ChromSizes& cSizes, bool fill);
+
+		// Releases all kept chroms
+		static void Clear() { lock_guard<mutex> lock(_lock); _seqs.clear(); }
+	};
+
+	// Returns loaded chrom: kept one in server mode, otherwise new one
+	//	@cID: chrom ID
+	//	@cSizes: chrom sizes
+	//	@arena: thread's buffer keeper to place the nucleotides, or NULL to allocate own buffer
+	static shared_ptr<RefSeq> LoadSeq(chrid cID, const ChromSizes& cSizes, SeqArena* arena = NULL);
+
 	static bool	UniScore;	// true if template features scores are ignored
 	static BYTE	ThrCnt;			// actual number of threads
+	static size_t MemLimit;		// memory limit in bytes, or 0 if unlimited
+	static BYTE	RepCnt;			// number of replicates generated in a single pass
+	static vector<chrid> ShardedIDs;	// sorted IDs of chroms treated by all shards, or empty if no shards
+	static ULLONG FragsLimit;	// limit of recorded frags: the stated one, or its share in shard mode
 	static bool	IsExo;
 	static bool	IsMDA;
 	static eMode TMode;			// current task mode
@@ -655,14 +1064,15 @@ public:
 		//bool	uniformScore,		// true if uniform template score is assigned
 		//readlen bindLen,
 		//const pairVal& flattens
-		UINT	unstBindLen			// unstable binding length
+		UINT	unstBindLen,		// unstable binding length
+		BYTE	repCnt				// number of replicates
 	);
 
 	// Creates singleton instance.
-	//  @cFiles: list of chromosomes as fa-files
-	//	@ocSizes: chrom sizes
-	inline Imitator(const ChromSizesExt& cSizes, Output& oFile)
-		: _cSizes(cSizes), _oFile(oFile) { Imit = this; }
+	//	@cSizes: chrom sizes
+	//	@oFiles: output files of each replicate
+	inline Imitator(const ChromSizesExt& cSizes, const vector<unique_ptr<Output>>& oFiles)
+		: _cSizes(cSizes), _oFiles(oFiles) { Imit = this; }
 
 	// Runs task in current mode and write result to output files
 	//	@templ: input template or NULL
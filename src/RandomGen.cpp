@@ -130,22 +130,37 @@ Normal(): mean = 0, SD = 1
 */
 
 Random::Random() : _normal_x2(DRand())//, distribution(ExpLambda)
+{
+	Init(Seed);
+}
+
+// Initializes generator state by given seed
+void Random::Init(int seed)
 {
 #ifdef RAND_STD
-	srand((unsigned)Seed);
-	_seed = Seed;
+	srand((unsigned)seed);
+	_seed = seed;
 #elif defined RAND_MT
-	mt[0] = Seed;
+	mt[0] = seed;
 	for (mti = 1; mti < MERS_N; mti++)
 		mt[mti] = (1812433253UL * (mt[mti - 1] ^ (mt[mti - 1] >> 30)) + mti);
 	for (int i = 0; i < 37; i++) rand();		// Randomize some more
 #elif defined RAND_XORSHIFT
-	x = Seed;
+	x = seed;
 	// initialize to fix random generator. Any initialization of y, w, z in fact
 	y = x >> 1;	 w = y + 1000;  z = w >> 1;
 #endif
 }
 
+// Restarts generation by the independent stream derived from the seed,
+// so the stream does not depend on the previous generation
+//	@stream: stream's number, e.g. chromosome's ID
+void Random::Reset(ULONG stream)
+{
+	Init(Seed ^ int(uint32_t(stream + 1) * 0x9E3779B9u));	// golden ratio spreads close numbers
+	_phase = 0;
+}
+
 #ifdef RAND_MT
 // Generates 32 random bits
 uint32_t Random::rand()
@@ -160,6 +160,9 @@ private:
 	double	_normal_x2;		// second random coordinate (for normal())
 	short	_phase;			// phase (for normal RNG)
 
+	// Initializes generator state by given seed
+	void Init(int seed);
+
 protected:
 	// Generates random double number within interval 0 <= x < 1
 	inline double DRand() { return (double)rand() / RAND_MAX_; }
@@ -176,6 +179,11 @@ public:
 
 	Random();
 
+	// Restarts generation by the independent stream derived from the seed,
+	// so the stream does not depend on the previous generation
+	//	@stream: stream's number, e.g. chromosome's ID
+	void Reset(ULONG stream);
+
 	// Returns random integer within interval [1, max]
 	int	Range(int max);
 
@@ -12,6 +12,9 @@ Provides read|write text file functionality
 #ifndef _FILE_WRITE
 #include <fstream>
 #endif
+#ifdef __unix__
+#include <fcntl.h>	// posix_fadvise(), fallocate()
+#endif
 
 const BYTE TabFilePar::BGLnLen = Chrom::MaxAbbrNameLength + 2 * 9;	// 2*pos + correction
 const BYTE TabFilePar::WvsLnLen = 9 + 3 + 2 + 25;	// pos + val + TAB + LF + correction
@@ -93,14 +96,14 @@ void TxtFile::SetError(Err::eCode errCode, const string& senderSpec, const strin
 //	@mode: opening mode
 //	@fStream: clonable file stream or NULL
 //	return: true if success, otherwise false.
-bool TxtFile::SetBasic(const string& fName, eAction mode, void* fStream)
+bool TxtFile::SetBasic(const string& fName, eAction mode, void* fStream, BYTE blkCnt)
 {
 	_buff = NULL;
 	_stream = NULL;
 	_errCode = Err::NONE;
 	_fName = fName;
 	_currRecPos = _recCnt = 0;
-	_buffLen = BlockSize;	// by default; can be corrected
+	_buffLen = blkCnt * BlockSize;	// by default; can be corrected
 #ifdef _NO_ZLIB
 	if(IsZipped()) { SetError(Err::FZ_BUILD); return false; }
 #endif
@@ -116,8 +119,14 @@ bool TxtFile::SetBasic(const string& fName, eAction mode, void* fStream)
 			}
 		else
 #endif
-			if( _stream = fopen(fName.c_str(), modes[int(mode)]))
+			if( _stream = fopen(fName.c_str(), modes[int(mode)])) {
 				setvbuf((FILE*)_stream, NULL, _IONBF, 0);
+#ifdef __unix__
+				// reading is strictly serial: let the kernel read ahead more aggressively
+				if(mode == eAction::READ)
+					posix_fadvise(fileno((FILE*)_stream), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+			}
 			else
 				SetError(Err::F_OPEN);
 	return IsGood();
@@ -137,13 +146,14 @@ bool TxtFile::CreateIOBuff()
 //	@mode: opening mode
 //	@msgFName: true if file name should be printed in exception's message
 //	@abortInvalid: true if invalid instance shold be completed by throwing exception
-TxtFile::TxtFile (const string& fName, eAction mode, bool msgFName, bool abortInvalid) :
+//	@blkCnt: number of basic blocks in the I/O buffer (read-ahead size)
+TxtFile::TxtFile (const string& fName, eAction mode, bool msgFName, bool abortInvalid, BYTE blkCnt) :
 	_flag(1)	// LF size set to 1
 {
 	SetFlag(ZIPPED, FS::HasGzipExt(fName));
 	SetFlag(ABORTING, abortInvalid);
 	SetFlag(PRNAME, msgFName);
-	if( !SetBasic(fName, mode, NULL) )	return;
+	if( !SetBasic(fName, mode, NULL, blkCnt) )	return;
 	_fSize = FS::Size(fName.c_str());
 	if(_fSize == -1)	_fSize = 0;		// new file
 #ifndef _NO_ZLIB
@@ -175,6 +185,8 @@ TxtFile::TxtFile (const string& fName, eAction mode, bool msgFName, bool abortIn
 }
 
 #ifdef _MULTITHREAD
+size_t TxtFile::CloneBuffLen = TxtFile::BlockSize;
+
 // Constructs a clone of an existing instance.
 // Clone is a copy of opened file with its own separate write basic and write line buffers.
 //	Used for multithreading file recording
@@ -183,6 +195,7 @@ TxtFile::TxtFile (const string& fName, eAction mode, bool msgFName, bool abortIn
 TxtFile::TxtFile(const TxtFile& file) : _flag(file._flag)
 {
 	if( !SetBasic("Clone " + file._fName, eAction::WRITE, file._stream) )	return;
+	_buffLen = CloneBuffLen;
 	RaiseFlag(CLONE);
 	RaiseFlag(MTHREAD);
 	file.RaiseFlag(MTHREAD);
@@ -205,6 +218,19 @@ TxtFile::~TxtFile()
 	//cout << "Free " << _fName << "\trecords = " << _recCnt << endl;
 }
 
+// Preallocates disk space for the file written from scratch, to reduce its fragmentation;
+// the file length is not changed, so an overestimated size never leaves a tail in the file.
+// Has no effect for zipped file, clone, or outside Linux.
+//	@size: estimated file length in bytes
+void TxtFile::Reserve(LLONG size)
+{
+#ifdef __linux__
+	// small file is written by a few blocks anyway
+	if(IsZipped() || IsClone() || !_stream || size <= LLONG(_buffLen))	return;
+	fallocate(fileno((FILE*)_stream), FALLOC_FL_KEEP_SIZE, 0, size);	// failure is harmless
+#endif
+}
+
 /************************ TxtFile: end ************************/
 
 /************************ TxtInFile ************************/
@@ -215,13 +241,14 @@ TxtFile::~TxtFile()
 //	@cntRecLines: number of lines in a record
 //	@msgFName: true if file name should be printed in an exception's message
 //	@abortInvalid: true if invalid instance should be completed by throwing exception
+//	@blkCnt: number of basic blocks in the I/O buffer (read-ahead size)
 TxtInFile::TxtInFile(const string& fName, eAction mode, 
-	BYTE cntRecLines, bool msgFName, bool abortInvalid) :
+	BYTE cntRecLines, bool msgFName, bool abortInvalid, BYTE blkCnt) :
 	_linesLen(NULL),
 	_recLineCnt(cntRecLines),
 	_recLen(0),
 	_readedLen(0),
-	TxtFile(fName, mode, msgFName, abortInvalid)
+	TxtFile(fName, mode, msgFName, abortInvalid, blkCnt)
 {
 	//ClearBuff();
 	if(Length() && ReadBlock(0) >= 0)		// read first block
@@ -405,6 +432,24 @@ lf:				_recLen += (_linesLen[rec] = ++i - currPos);
 	return RealRecord();
 }
 
+// Gets the unread rest of the current block as a raw chunk, reading the next block if necessary.
+// Lines are not parsed, so it is used to read the rest of file in one pass.
+//	@len: returned length of chunk
+//	return: pointer to the chunk or NULL if file is finished
+const char* TxtInFile::GetNextChunk(size_t& len)
+{
+	if(IsFlag(ENDREAD))	return NULL;
+	if(_currRecPos >= _readedLen
+	&& (_readedLen != _buffLen || ReadBlock(0) <= 0)) {	// final block is exhausted
+		RaiseFlag(ENDREAD);
+		return NULL;
+	}
+	len = _readedLen - _currRecPos;
+	const char* chunk = _buff + _currRecPos;
+	_currRecPos = _readedLen;
+	return chunk;
+}
+
 // Returns the read pointer to the beginning of the last read line and decreases line counter. 
 //	Zeroes length of current reading record! 
 //	For this reason it cannot be called more then once after each GetNextRecord() invoke
@@ -484,6 +529,7 @@ TxtOutFile::~TxtOutFile()
 TxtOutFile::TxtOutFile(const TxtOutFile& file):
 	_lineBuffOffset(file._lineBuffOffset),
 	_delim(file._delim),
+	_mtype(file._mtype),
 	TxtFile(file)
 {
 	if( !CreateLineBuff(file._lineBuffLen) )	return;
@@ -892,13 +938,15 @@ void ChromDefRegions::AddRegion(const Region& rgn, chrlen minGapLen)
 void ChromDefRegions::Write() const
 {
 	if(!_new || FS::IsShortFileName(_fName))	return;
+	const string tmpName = FS::TmpFileName(_fName);	// concurrent runs may share service dir
 	ofstream file;
 
-	file.open (_fName.c_str(), ios_base::out);
+	file.open (tmpName.c_str(), ios_base::out);
 	file << "SumGapLen:" << TAB << _gapLen << LF;
 	for(Iter it=Begin(); it!=End(); it++)
 		file << it->Start << TAB << it->End << LF;
 	file.close();
+	FS::CommitFile(tmpName, _fName);
 	_new = false;
 }
 
@@ -924,94 +972,103 @@ void ChromDefRegions::Combine(chrlen minGapLen)
 
 /************************ class FaFile ************************/
 
-// Adds a gap to assign defined regions
-//	@start: gap's start position.
-//	@len: gap's length
-void FaFile::DefRgnMaker::AddGap(chrlen start, chrlen len)
+// Adds current 'N' run as a gap if it is not a single 'N'
+void FaFile::DefRgnMaker::FlushGap()
 {
-	_defRgn.End = (start += _currPos);
+	if(_gap.Length() < 2)	return;
+	_defRgn.End = _gap.Start;
 	_defRgns.AddRegion(_defRgn, _minGapLen);
-	_defRgn.Start = start + len;
-	_defRgns.IncrGapLen(len);
+	_defRgn.Start = _gap.End;
+	_defRgns.IncrGapLen(_gap.Length());
 }
 
-// Closes adding gaps, saves hrom's defined regions
+// Accepts 'N' run; adjacent runs (separated by LF only) are joined
+//	@start: run's start position in chrom
+//	@len: run's length
+void FaFile::DefRgnMaker::AddNRun(chrlen start, chrlen len)
+{
+	if(start == _gap.End)	_gap.End += len;	// continuation of the current run
+	else {
+		FlushGap();
+		_gap.Set(start, start + len);
+	}
+}
+
+// Closes adding gaps, saves chrom's defined regions
 //	@cLen: chrom length
 void FaFile::DefRgnMaker::CloseAddGaps(chrlen cLen)
 {
+	FlushGap();
 	_defRgn.End = cLen;
 	_defRgns.AddRegion(_defRgn, _minGapLen);
 	_defRgns.Write(); 
 }
 
-// Search 'N' subsequence in the current line beginning from the start position
-// and adds complete 'N' subsequence to _rgnMaker
-//	@startPos: starting line reading position
-//	@NCnt: number of 'N' in the line beginning from the start position
-//	return: true if line trimming is complete, false for single 'N'
-void FaFile::CountN(chrlen startPos, chrlen NCnt)
+// Copies a piece of line without LF to the sequence and searches 'N' runs in it
+//	@src: piece of line
+//	@len: length of piece
+//	@seq: sequence buffer or NULL
+//	@pos: current position in the sequence; increased by len
+void FaFile::TakeSeq(const char* src, chrlen len, char* seq, chrlen& pos)
 {
-	if(NCnt == 1)	return;
-
-	const char* line = Line();
-	const chrlen lineLen = LineLength();
-	chrlen nCnt = 0, iN;				// local count N, first N index
-	bool firstN = true;
-
-	for(chrlen i=startPos; i<lineLen; i++)
-		if(line[i] == cN) {					// some 'N' subsequence begins?
-			nCnt++;
-			if(firstN)	{ iN = i; firstN = false; }
-		}		
-		else if(nCnt)						// is current subsequence finished?
-			if(nCnt == 1) {					// was it a single 'N'?
-				nCnt = 0; NCnt--; firstN = true;	
-			}
-			else {							// continuous 'N' sequence?
-				_rgnMaker->AddGap(iN, nCnt);	// add complete 'N' subsequence
-				CountN(i++, NCnt - nCnt);	// search in the rest of line
-				break;
-			}
+	if(seq && pos < _cLen)		// the length of zipped file can be estimated inaccurately
+		memcpy(seq + pos, src, pos + len > _cLen ? _cLen - pos : len);
+	if(_rgnMaker) {
+		const char* end = src + len;
+		// memchr is vectorized, so the run's start is found much faster than by byte-wise loop
+		for(const char* n = src; n = (const char*)memchr(n, cN, end - n); ) {
+			const char* nEnd = n + 1;
+			while(nEnd < end && *nEnd == cN)	nEnd++;
+			_rgnMaker->AddNRun(pos + chrlen(n - src), chrlen(nEnd - n));
+			n = nEnd;
+		}
+	}
+	pos += len;
 }
 
-// Reads line and set it as current, and generates regions
-// Since method scans the line, it takes no overhead expenses to do this.
-//	@pocket: external temporary variables
-//	return: current line.
-const char* FaFile::GetLineWitnNControl() 
+// Reads the whole sequence directly into external buffer (with filling def regions if necessary)
+//	@seq: sequence buffer with capacity of ChromLength(), or NULL to fill def regions only
+//	return: actual length of sequence
+chrlen FaFile::ReadSeq(char* seq)
 {
-	chrlen nCnt = 0;	// number of 'N' in line
-	const char* line = GetNextRecord(nCnt);
-	if(line) {
-		const chrlen len = LineLength();
-		if(nCnt)
-			if(nCnt == len)	_rgnMaker->AddGap(0, nCnt);	// the whole line is filled by 'N'
-			else			CountN(0, nCnt);
-		_rgnMaker->AddLineLen(len);
-	}
-	return line;
+	chrlen pos = 0;
+	const char* chunk = Line();		// first line is readed by FaFile()
+	if(!chunk)	return pos;
+	size_t len = LineLength();
+
+	if(len && chunk[len - 1] == CR)	len--;
+	TakeSeq(chunk, chrlen(len), seq, pos);
+	while(chunk = GetNextChunk(len))
+		for(const char* end = chunk + len; chunk < end; ) {
+			const char* lf = (const char*)memchr(chunk, LF, end - chunk);
+			if(!lf)		lf = end;		// line is continued in the next block
+			len = lf - chunk;
+			if(len && chunk[len - 1] == CR)	len--;
+			if(len)	TakeSeq(chunk, chrlen(len), seq, pos);
+			chunk = lf + 1;
+		}
+	if(pos > _cLen)	pos = _cLen;	// for zipped file with unpredictable length
+	return pos;
 }
 
 // Opens existing file and reads first line.
 //	@rgns: def regions to fill, otherwise NULL to reading without 'N' control
-FaFile::FaFile(const string& fName, ChromDefRegions* rgns) : TxtInFile(fName, eAction::READ, 1)
+FaFile::FaFile(const string& fName, ChromDefRegions* rgns) :
+	TxtInFile(fName, eAction::READ, 1, true, true, BlkCnt)
 {
-	if (rgns) {
-		_rgnMaker.reset(new DefRgnMaker(*rgns, 2));
-		_pGetLine = &FaFile::GetLineWitnNControl;
-	}
-	else _pGetLine = &FaFile::GetNextRecord;
+	if (rgns)	_rgnMaker.reset(new DefRgnMaker(*rgns, 2));
 
 	chrlen len = chrlen(Length());
-	if(NextGetLine()[0] == FaComment) {		// is first line a header?
+	const char* line = GetNextRecord();
+	if(line && line[0] == FaComment) {		// is first line a header?
 		len -= RecordLength();
-		if(_rgnMaker)	_rgnMaker->RemoveLineLen(LineLength());
-		NextGetLine();
+		line = GetNextRecord();
 	}
 	// set chrom length
-	_cLen = len - LFSize() *
+	_cLen = line ? len - LFSize() *
 		(len/RecordLength() +		// amount of LF markers for whole lines
-		bool(len%RecordLength()));	// LF for part line
+		bool(len%RecordLength())) :	// LF for part line
+		0;
 }
 
 /************************ end of class FaFile ************************/
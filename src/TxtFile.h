@@ -135,6 +135,14 @@ public:
 		READ_ANY	// creates file if it not exist and reads it
 	};
 
+#ifdef _MULTITHREAD
+	static const size_t	MinCloneBuffLen = 64 * 1024;	// minimum length of the clone's I/O buffer
+	static size_t	CloneBuffLen;	// length of the clone's I/O buffer; may be reduced to save memory
+
+	// Restores the default length of the clone's I/O buffer
+	inline static void ResetCloneBuffLen() { CloneBuffLen = BlockSize; }
+#endif
+
 protected:
 	enum eFlag {			// signs of file
 		// The first two right bits are reserved for storing the length of the LF marker: 1 or 2 
@@ -196,8 +204,9 @@ private:
 	//	@fName: valid full name of file
 	//	@mode: opening mode
 	//	@fStream: clonable file stream or NULL
+	//	@blkCnt: number of basic blocks in the I/O buffer
 	//	return: true is success, otherwise false.
-	bool SetBasic(const string& fName, eAction mode, void* fStream);
+	bool SetBasic(const string& fName, eAction mode, void* fStream, BYTE blkCnt = 1);
 	
 	// Allocates memory for the I/O buffer with checking.
 	//	return: true if successful
@@ -211,7 +220,9 @@ protected:
 	//	@mode: opening mode
 	//	@msgFName: true if file name should be printed in the exception's message
 	//	@abortInvalid: true if invalid instance shold be completed by throwing exception
-	TxtFile(const string& fName, eAction mode, bool msgFName =true, bool abortInvalid = true);
+	//	@blkCnt: number of basic blocks in the I/O buffer (read-ahead size)
+	TxtFile(const string& fName, eAction mode,
+		bool msgFName =true, bool abortInvalid = true, BYTE blkCnt = 1);
 
 #ifdef _MULTITHREAD
 	// Constructs a clone of an existing instance.
@@ -252,6 +263,12 @@ public:
 	// Gets number of readed/writed records.
 	ULONG RecordCount() const { return _recCnt; }
 
+	// Preallocates disk space for the file written from scratch, to reduce its fragmentation;
+	// the file length is not changed, so an overestimated size never leaves a tail in the file.
+	// Has no effect for zipped file, clone, or outside Linux.
+	//	@size: estimated file length in bytes
+	void Reserve(LLONG size);
+
 	// Throws exception
 	//	@msg: exception message
 	inline void ThrowExcept(const string& msg) const { Err(msg, CondFileName()).Throw(); }
@@ -301,8 +318,9 @@ protected:
 	//	@cntRecLines: number of lines in a record
 	//	@msgFName: true if file name should be printed in an exception's message
 	//	@abortInvalid: true if invalid instance should be completed by throwing exception
+	//	@blkCnt: number of basic blocks in the I/O buffer (read-ahead size)
 	TxtInFile(const string& fName, eAction mode, BYTE cntRecLines,
-		bool msgFName = true, bool abortInvalid=true);
+		bool msgFName = true, bool abortInvalid=true, BYTE blkCnt = 1);
 
 	inline ~TxtInFile() { if(_linesLen)	delete [] _linesLen; }
 
@@ -324,6 +342,12 @@ protected:
 	//	return: pointer to line or NULL if no more lines
 	char*	GetNextRecord(short* const tabPos, const BYTE tabCnt);
 
+	// Gets the unread rest of the current block as a raw chunk, reading the next block if necessary.
+	// Lines are not parsed, so it is used to read the rest of file in one pass.
+	//	@len: returned length of chunk
+	//	return: pointer to the chunk or NULL if file is finished
+	const char*	GetNextChunk(size_t& len);
+
 #if defined _CALLDIST || defined _FQSTATN
 	// Gets next record
 	//	return: point to the next record in a buffer.
@@ -774,46 +798,39 @@ class FaFile : public TxtInFile
 	// 'DefRgnMaker' produced chrom defined regions while FaFile reading 
 	class DefRgnMaker
 	{
-		chrlen	_minGapLen,			// minimal length which defines gap as a real gap
-				_currPos;			// current readed nt position
+		chrlen	_minGapLen;			// minimal length which defines gap as a real gap
 		Region	_defRgn;			// current defined region
+		Region	_gap;				// current unclosed 'N' run
 		ChromDefRegions& _defRgns;	// external chrom's defined regions
 
+		// Adds current 'N' run as a gap if it is not a single 'N'
+		void FlushGap();
+
 	public:
 		inline DefRgnMaker(ChromDefRegions& rgns, chrlen minGapLen)
-			: _minGapLen(minGapLen), _currPos(0), _defRgns(rgns) { _defRgns.Clear(); }
-
-		// Adds last readed line length
-		inline void AddLineLen(chrlen lineLen) { _currPos += lineLen; }
+			: _minGapLen(minGapLen), _defRgns(rgns) { _defRgns.Clear(); }
 
-		// Remove last readed line length
-		inline void RemoveLineLen(chrlen lineLen) { _currPos -= lineLen; }
+		// Accepts 'N' run; adjacent runs (separated by LF only) are joined
+		//	@start: run's start position in chrom
+		//	@len: run's length
+		void AddNRun(chrlen start, chrlen len);
 
-		// Adds a gap to assign defined regions
-		//	@start: gap's start position.
-		//	@len: gap's length
-		void AddGap(chrlen start, chrlen len);
-
-		// Closes adding gaps, saves hrom's defined regions
+		// Closes adding gaps, saves chrom's defined regions
 		//	@cLen: chrom length
 		void CloseAddGaps(chrlen cLen);
 	};
 
+	static const BYTE BlkCnt = 8;	// number of basic blocks in the read-ahead buffer
 	const char FaComment = '>';
 	chrlen		_cLen;						// length of chromosome
-	const char* (FaFile::* _pGetLine)();	// pointer to the 'GetNextLine' method
 	unique_ptr<DefRgnMaker> _rgnMaker;		// chrom defined regions store
 
-	// Search 'N' subsequence in the current line beginning from the start position
-	// and adds complete 'N' subsequence to _rgnMaker
-	//	@startPos: starting line reading position
-	//	@NCnt: number of 'N' in the line beginning from the start position
-	//	return: true if line trimming is complete, false for single 'N'
-	void CountN(chrlen startPos, chrlen NCnt);
-
-	// Reads line and set it as current with def filling regions
-	// Since method scans the line, it takes no overhead expenses to do this.
-	const char* GetLineWitnNControl();
+	// Copies a piece of line without LF to the sequence and searches 'N' runs in it
+	//	@src: piece of line
+	//	@len: length of piece
+	//	@seq: sequence buffer or NULL
+	//	@pos: current position in the sequence; increased by len
+	void TakeSeq(const char* src, chrlen len, char* seq, chrlen& pos);
 
 public:
 	// Opens existing file and reads first line.
@@ -823,8 +840,10 @@ public:
 	// Gets chromosome's length
 	inline chrlen ChromLength() const { return _cLen; }
 
-	// Reads line and set it as current (with filling def regions if necessary)
-	inline const char* NextGetLine()	{ return (this->*_pGetLine)(); }
+	// Reads the whole sequence directly into external buffer (with filling def regions if necessary)
+	//	@seq: sequence buffer with capacity of ChromLength(), or NULL to fill def regions only
+	//	return: actual length of sequence
+	chrlen ReadSeq(char* seq);
 
 	// Closes reading
 	inline void CLoseReading()	{ if(_rgnMaker)	_rgnMaker->CloseAddGaps(_cLen); }
@@ -10,12 +10,17 @@ Provides common functionality
 #include "common.h"
 #include <sstream>
 #include <algorithm>	// std::transform, REAL_SLASH
+#include <fstream>		// Affinity::ReadList()
 #ifdef OS_Windows
 	#define SLASH '\\'		// standard Windows path separator
 	#define REAL_SLASH '/'	// is permitted in Windows too
 #else
 	#define SLASH '/'		// standard Linux path separator
 #endif
+#ifdef __linux__
+	#include <sched.h>		// sched_getaffinity()
+	#include <pthread.h>	// pthread_setaffinity_np()
+#endif
 
 /************************ common Functions ************************/
 
@@ -170,6 +175,7 @@ const char* Options::sPrTime = "print run time";
 const char* Options::sPrUsage = "print usage information";
 const char* Options::sPrVersion = "print program's version";
 const char* Options::Booleans [] = {"OFF","ON"};
+vector<Options::Default> Options::Defaults;
 const char* Options::TypeNames [] = {
 	NULL, "<name>", "<char>", "<int>", "<float>", "<long>", NULL, NULL,
 	"<[int]:[int]>", "<[float]:[float]>", NULL, NULL, NULL
@@ -626,6 +632,19 @@ int Options::SetOption (char* opt, char* val, char* nextItem, int& argInd)
 	return 0;
 }
 
+// Returns index of option stated by command line argument, or -1 if argument is not an option
+//	@arg: command line argument: short option without united ones, or long option
+int Options::OptIndex(const char* arg)
+{
+	if(arg[0] != HPH || !arg[1])	return -1;
+	for(int i=0; i<OptCount; i++)
+		if( arg[1] == HPH ?
+			List[i].Str && !strcmp(List[i].Str, arg+2) :
+			List[i].Char == arg[1] && !arg[2] )
+			return i;
+	return -1;
+}
+
 // Returns true if long option opt is defined
 bool Options::Find(const char* opt)
 {
@@ -727,6 +746,12 @@ string const Options::CommandLine(int argc, char* argv[])
 //	or negative if tokenize complets wrong
 int Options::Parse(int argc, char* argv[], const char* obligPar)
 {
+	if (Defaults.empty())
+		for (int i = 0; i < OptCount; i++) {
+			const Option& opt = List[i];
+			const bool isPair = (opt.ValType == tPR_INT || opt.ValType == tPR_FL) && opt.SVal;
+			Defaults.push_back({ opt.NVal, opt.SVal, opt.Sign, isPair ? *(pairVal*)opt.SVal : pairVal() });
+		}
 	if (argc < 2)	{ Options::PrintUsage(true); return -1; }		// output tip	
 	int i, res = 1;
 	char *token, *nextToken;	// option or parameter
@@ -756,6 +781,21 @@ int Options::Parse(int argc, char* argv[], const char* obligPar)
 	return i * res;
 }
 
+// Restores the initial values of all options,
+// so that the next Parse() in the same process starts from scratch
+void Options::Reset()
+{
+	for (size_t i = 0; i < Defaults.size(); i++) {
+		Option& opt = List[i];
+		const Default& def = Defaults[i];
+
+		opt.NVal = def.NVal;
+		opt.SVal = def.SVal;
+		opt.Sign = def.Sign;
+		if ((opt.ValType == tPR_INT || opt.ValType == tPR_FL) && opt.SVal)	*(pairVal*)opt.SVal = def.Pair;
+	}
+}
+
 // Return string value by index: if value is not oblig and is not specified, than defName with given extention
 const string Options::GetFileName(int indOpt, const char* defName, const string& ext)
 {
@@ -1107,6 +1147,32 @@ string const FS::MakePath(const string& name)
 	return name[name.length()-1] == SLASH ? name : name + SLASH;
 }
 
+// Returns temporary file name unique for the process, placed in the same directory
+//	@fname: target file name
+string const FS::TmpFileName(const string& fname)
+{
+#ifdef OS_Windows
+	return fname + DOT + to_string(GetCurrentProcessId()) + ".tmp";
+#else
+	return fname + DOT + to_string(getpid()) + ".tmp";
+#endif
+}
+
+// Replaces target file by the temporary one in a single step
+//	@tmpName: temporary file name
+//	@fname: target file name
+//	return: true if successful
+bool FS::CommitFile(const string& tmpName, const string& fname)
+{
+#ifdef OS_Windows
+	if(MoveFileExA(tmpName.c_str(), fname.c_str(), MOVEFILE_REPLACE_EXISTING))	return true;
+#else
+	if(!rename(tmpName.c_str(), fname.c_str()))	return true;
+#endif
+	remove(tmpName.c_str());
+	return false;
+}
+
 #if !defined _WIGREG && !defined _FQSTATN
 // Fills external vector of strings by file's names found in given directory
 // Implementation depends of OS.
@@ -1260,6 +1326,104 @@ bool	Mutex::_active;		// true if the mutex really should work
 mutex	Mutex::_mutexes[int(Mutex::eType::NONE)];
 
 /************************  end of class Mutex ************************/
+
+/************************  class Affinity ************************/
+
+vector<int>	Affinity::CPUs;
+vector<int>	Affinity::Nodes;
+
+// Returns numbers listed in the system file, e.g. "0-3,8-11", or empty container if file is absent
+//	@fName: file name
+vector<int> Affinity::ReadList(const string& fName)
+{
+	vector<int> numbs;
+	ifstream file(fName);
+	string item;
+
+	while (getline(file, item, ',')) {
+		int first, last;
+		const int cnt = sscanf(item.c_str(), "%d-%d", &first, &last);
+		if (cnt < 1)	break;
+		if (cnt == 1)	last = first;
+		for (; first <= last; first++)	numbs.push_back(first);
+	}
+	return numbs;
+}
+
+// Sets pinning order of the CPUs allowed to the process
+void Affinity::Init()
+{
+	Reset();
+#ifdef __linux__
+	static const string sysPath = "/sys/devices/system/";
+	cpu_set_t allowed;
+	vector<vector<int>> nodeCPUs;	// allowed CPUs of each node: physical cores, then their siblings
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))	return;
+	vector<int> nodes = ReadList(sysPath + "node/online");
+	if (!nodes.size())	nodes.push_back(0);		// non-NUMA system
+	for (int n : nodes) {
+		vector<int> cpus = ReadList(sysPath + "node/node" + to_string(n) + "/cpulist");
+		vector<int> siblings;
+
+		if (!cpus.size())
+			for (int c = 0; c < CPU_SETSIZE; c++)	cpus.push_back(c);
+		nodeCPUs.emplace_back();
+		for (int c : cpus) {
+			if (!CPU_ISSET(c, &allowed))	continue;
+			// physical core is represented by its first allowed SMT sibling
+			const vector<int> sibls = 
+				ReadList(sysPath + "cpu/cpu" + to_string(c) + "/topology/thread_siblings_list");
+			const auto it = find_if(sibls.begin(), sibls.end(),
+				[&](int s) { return CPU_ISSET(s, &allowed); });
+			(it == sibls.end() || *it == c ? nodeCPUs.back() : siblings).push_back(c);
+		}
+		nodeCPUs.back().insert(nodeCPUs.back().end(), siblings.begin(), siblings.end());
+	}
+	// alternate the nodes
+	for (size_t i = 0, cnt = 1; cnt; i++) {
+		cnt = 0;
+		for (size_t n = 0; n < nodes.size(); n++)
+			if (i < nodeCPUs[n].size()) {
+				CPUs.push_back(nodeCPUs[n][i]);
+				Nodes.push_back(nodes[n]);
+				cnt++;
+			}
+	}
+#else
+	Err("thread pinning is not supported on this system").Warning();
+#endif
+}
+
+// Pins current thread to its CPU; does nothing if pinning is not set
+//	@tID: thread ID
+void Affinity::Pin(thrid tID)
+{
+	if (!IsSet())	return;
+#ifdef __linux__
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(CPU(tID), &cpus);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+		Err("thread " + to_string(tID) + ": cannot be pinned to CPU " + to_string(CPU(tID))).Warning();
+#endif
+}
+
+// Prints CPUs of the threads
+//	@signOut: output marker
+//	@thrCnt: number of threads
+void Affinity::Print(const char* signOut, thrid thrCnt)
+{
+	if (!IsSet())	return;
+	cout << signOut << "Pinned threads" << SepCl;
+	for (thrid i = 0; i < thrCnt; i++)
+		cout << (i ? SepCm : "") << "CPU " << CPUs[i % CPUs.size()]
+			 << " (node " << Nodes[i % CPUs.size()] << ')';
+	cout << LF;
+}
+
+/************************  end of class Affinity ************************/
 #endif	// _MULTITHREAD
 
 /************************ class Chrom ************************/
@@ -1288,13 +1452,22 @@ chrid Chrom::HeteroID	(const char cMark)
 	return UnID;
 }
 
+// Gets autosome number by mark without control, or 0 if it exceeds chrid capacity
+//	@cMark: mark starting with digit
+ULONG Chrom::AutosomeNumb(const char* cMark)
+{
+	const ULONG numb = strtoul(cMark, NULL, 10);
+	// heterosome IDs follow the last autosome and should remain below UnID
+	return numb > ULONG(UnID) - strlen(Marks) ? 0 : numb;
+}
+
 // Gets chrom ID by case insensitive mark
 //	firstHeteroID should be initialized!
 chrid Chrom::CaseInsID	(const char* cMark)
 {
 	if(isdigit(*cMark))	{				// autosome
-		chrid id = atoi(cMark) - 1;
-		return id < firstHeteroID ? id : UnID;
+		const ULONG numb = AutosomeNumb(cMark);
+		return numb && numb <= firstHeteroID ? chrid(numb - 1) : UnID;
 	}
 	return CaseInsHeteroID(*cMark);		// heterosome
 }
@@ -1334,7 +1507,7 @@ short Chrom::PrefixLength(const char* cName)
 //  @prefixLen: length of name prefix
 chrid Chrom::ID(const char* cName, size_t prefixLen)
 {
-	return isdigit(*(cName+=prefixLen)) ? atoi(cName)-1 : HeteroID(*cName);
+	return isdigit(*(cName+=prefixLen)) ? chrid(AutosomeNumb(cName)-1) : HeteroID(*cName);
 }
 
 // Validates chrom name and returns chrom ID
@@ -1344,11 +1517,14 @@ chrid Chrom::ValidateID(const char* cName, size_t prefixLen)
 {
 	if(!cName)					return UnID;
 	cName += prefixLen;							// skip prefix
-	for(int i=1; i<=MaxMarkLength; i++)
+	for(int i=1; i<=MaxMarkLength && cName[i]; i++)
 		if(cName[i] == USCORE)	return UnID;	// exclude chroms with '_'
 
 	if(isdigit(*cName))	{						// autosome
-		chrid id = atoi(cName);
+		const chrid id = chrid(AutosomeNumb(cName));
+		if(!id)
+			Err(sTitle + " number exceeds the maximum of "
+				+ to_string(ULONG(UnID) - strlen(Marks)), Abbr + string(cName, strspn(cName, "0123456789"))).Throw();
 		if(/*IsRelativeID() && */id > firstHeteroID)	firstHeteroID = id;
 		return id - 1;
 	}
@@ -90,7 +90,7 @@ Provides common functionality
 
 // specific types
 typedef BYTE		thrid;		// type number of thread
-typedef BYTE		chrid;		// type number of chromosome
+typedef uint16_t	chrid;		// type number of chromosome; wide enough for scaffold-level assemblies
 typedef uint16_t	readlen;	// type length of Read
 typedef uint32_t	chrlen;		// type length of chromosome
 typedef chrlen		fraglen;	// type length of fragment
@@ -534,6 +534,15 @@ private:
 						UsageCount;		// count of 'Usage' variants in help
 	static 	Option		List[];			// list of options. Option 'help' always shuld be
 										// the last one, option 'version' - before last.
+
+	// 'Default' keeps the initial option's value
+	struct Default {
+		float	NVal;		// numeric|enum value
+		const char*	SVal;	// string value
+		Signs	Sign;		// signs
+		pairVal	Pair;		// pair value for the pair options
+	};
+	static vector<Default>	Defaults;	// initial values of options, saved by the first Parse()
 	
 	// Check obligatory options and output message about first absent obligatory option.
 	//	return: -1 if some of obligatory options does not exists, otherwise 1
@@ -597,9 +606,17 @@ public:
 	//	@argv: array of main() parameters
 	static const string CommandLine(int argc, char* argv[]);
 
+	// Returns index of option stated by command line argument, or -1 if argument is not an option
+	//	@arg: command line argument: short option without united ones, or long option
+	static int OptIndex(const char* arg);
+
 	// Reset int option value to 0
 	inline static void ResetIntVal(int opt) {  List[opt].NVal = 0; }
 
+	// Restores the initial values of all options,
+	// so that the next Parse() in the same process starts from scratch
+	static void Reset();
+
 	// Parses and checks main() parameters and their values.
 	//	Output message if some of them is wrong.
 	//	@argc: count of main() pearmeters
@@ -945,6 +962,20 @@ public:
 	// Returns the name ended by slash without checking
 	static string const MakePath(const string& name);
 
+	// === atomic writing
+
+	// Returns temporary file name unique for the process, placed in the same directory
+	//	@fname: target file name
+	static string const TmpFileName(const string& fname);
+
+	// Replaces target file by the temporary one in a single step,
+	// so concurrent readers never see a partially written file.
+	// Temporary file is removed in case of failure.
+	//	@tmpName: temporary file name
+	//	@fname: target file name
+	//	return: true if successful
+	static bool CommitFile(const string& tmpName, const string& fname);
+
 	// === files in dir
 
 #if !defined _WIGREG && !defined _FQSTATN
@@ -1089,7 +1120,7 @@ static class Mutex
 public:
 	enum class eType { OUTPUT, INCR_SUM, WR_BED, WR_SAM, WR_FQ, 
 #ifdef _ISCHIP
-		WR_RDENS, WR_BG, WR_BGPOS, WR_BGNEG,
+		WR_FDENS, WR_RDENS, WR_BG, WR_BGPOS, WR_BGNEG, WR_REC,
 #endif
 		NONE };
 #ifdef _MULTITHREAD
@@ -1107,6 +1138,44 @@ public:
 #endif
 } myMutex;
 
+#ifdef _MULTITHREAD
+// 'Affinity' pins threads to CPUs: alternately over NUMA nodes, physical cores first,
+// so that the memory first touched by a pinned thread is allocated on its own node.
+// Implemented for Linux only.
+static class Affinity
+{
+	static vector<int>	CPUs;	// allowed CPUs in pinning order
+	static vector<int>	Nodes;	// node of each CPU in CPUs
+
+	// Returns numbers listed in the system file, e.g. "0-3,8-11", or empty container if file is absent
+	//	@fName: file name
+	static vector<int> ReadList(const string& fName);
+
+public:
+	// Returns true if pinning is set
+	inline static bool IsSet() { return CPUs.size(); }
+
+	// Sets pinning order of the CPUs allowed to the process
+	static void Init();
+
+	// Resets pinning
+	inline static void Reset() { CPUs.clear(); Nodes.clear(); }
+
+	// Returns CPU of the thread; pinning should be set
+	//	@tID: thread ID
+	inline static int CPU(thrid tID) { return CPUs[tID % CPUs.size()]; }
+
+	// Pins current thread to its CPU; does nothing if pinning is not set
+	//	@tID: thread ID
+	static void Pin(thrid tID);
+
+	// Prints CPUs of the threads
+	//	@signOut: output marker
+	//	@thrCnt: number of threads
+	static void Print(const char* signOut, thrid thrCnt);
+} affinity;
+#endif	// _MULTITHREAD
+
 // 'Chrom' establishes correspondence between chromosome's ID and it's name.
 static class Chrom
 /**********************************************************************************
@@ -1141,11 +1210,11 @@ a zero value indicates an absolute discipline, a non-zero value indicates a rela
 {
 public:
 	static const char*	Abbr;				// Chromosome abbreviation
-	static const BYTE	MaxMarkLength = 2;	// Maximal length of chrom's mark
+	static const BYTE	MaxMarkLength = 5;	// Maximal length of chrom's mark
 	static const BYTE	MaxAbbrNameLength;	// Maximal length of abbreviation chrom's name
 #ifndef _FQSTATN
 	static const string	Short;				// Chromosome shortening; do not convert to string in run-time
-	static const chrid	UnID = -1;			// Undefined ID (255)
+	static const chrid	UnID = -1;			// Undefined ID (65535)
 	static const chrid	Count = 24;			// Count of chromosomes by default (for container reserving)
 	static const BYTE	MaxShortNameLength;	// Maximal length of short chrom's name
 	static const BYTE	MaxNamedPosLength;	// Maximal length of named chrom's position 'chrX:12345'
@@ -1165,6 +1234,10 @@ private:
 	// Gets heterosome ID by mark without control, or undefined ID
 	static chrid HeteroID	(const char cMark);
 
+	// Gets autosome number by mark without control, or 0 if it exceeds chrid capacity
+	//	@cMark: mark starting with digit
+	static ULONG AutosomeNumb(const char* cMark);
+
 	// Gets heterosome ID by case insensitive mark, or undefined ID
 	inline static chrid CaseInsHeteroID(const char cMark) { return HeteroID( toupper(cMark) ); }
 
@@ -1178,6 +1251,9 @@ public:
 	// Returns true if chrom is autosome, false for somatic; for relative ID discipline only
 	inline static bool IsAutosome(chrid cid) { return cid < firstHeteroID; }
 
+	// Restores the initial IDs state before the next run in the same process
+	inline static void Reset() { cID = UnID; firstHeteroID = 0; }
+
 	// Gets the length of prefix, or -1 if name is not finded
 	static short PrefixLength(const char* cName);
 
@@ -1257,7 +1333,7 @@ public:
 
 	// Gets mark length by ID; used in WigMap (bioCC)
 	inline static size_t MarkLength(chrid cID) {
-		return cID == UnID ? UndefName.length() : (cID > firstHeteroID || cID < 9 ? 1 : 2);
+		return cID == UnID ? UndefName.length() : (cID >= firstHeteroID ? 1 : DigitsCount(cID + 1));
 	}
 
 	// Returns mark by ID
@@ -75,6 +75,35 @@ numb_id effPartition::IdNumbers::MaxID() const
 // Marks all numbers as unallocated
 void effPartition::IdNumbers::Reset() { for(numb_it it=begin(); it!=end(); it++->BinIInd = 0); }
 
+// Packs small numbers into batches of approximately equal sum, keeping large numbers as is.
+//	@batches: packed batches to be filled
+//	@ssCnt: count of subsets
+void effPartition::IdNumbers::Pack(numb_batches& batches, ss_id ssCnt)
+{
+	const size_t batchCnt = size_t(ssCnt) * BatchPerSubset;
+	if(size() <= batchCnt)	return;
+
+	ss_sum sum = 0;
+	for(const auto& n : *this)	sum += n.Val;
+	const ss_sum lim = sum / batchCnt;		// upper limit of batch's sum
+	IdNumbers packed;
+	size_t head = 0;						// index of the current batch head in packed
+
+	packed.reserve(batchCnt * 2);
+	for(const auto& n : *this)				// numbers are in ID order
+		if(n.Val >= lim)	packed.push_back(n);
+		else if(batches.size() && ss_sum(packed[head].Val) + n.Val <= lim) {
+			packed[head].Val += n.Val;
+			batches[packed[head].Id].push_back(n.Id);
+		}
+		else {								// start new batch
+			head = packed.size();
+			packed.push_back(n);
+			batches[n.Id].push_back(n.Id);
+		}
+	swap(packed);
+}
+
 // ********** Subset **********
 
 // Adds number
@@ -192,6 +221,23 @@ void effPartition::Result::Sort(bool ascend)
 	sort(Bins.begin(), Bins.end(), ascend ? Subset::SortByAscend : Subset::SortByDescend);
 }
 
+// Replaces batch heads by batch's number IDs in each subset
+//	@batches: packed batches
+void effPartition::Result::Unpack(const numb_batches& batches)
+{
+	for(auto& ss : Bins) {
+		numb_ids ids;
+
+		ids.reserve(ss.numbIDs.size());
+		for(numb_id id : ss.numbIDs) {
+			const auto it = batches.find(id);
+			if(it == batches.end())	ids.push_back(id);
+			else	ids.insert(ids.end(), it->second.begin(), it->second.end());
+		}
+		ss.numbIDs.swap(ids);
+	}
+}
+
 // Prints sorted in descending order instance
 //	@valW: maximum number value width (count of digits) to align vals right
 //	@prNumbsCnt: maximum count of printed number IDs or 0 if all (by default)
@@ -476,7 +522,17 @@ void effPartition::Init(IdNumbers& numbers, ss_id ssCnt, UINT limMult)
 effPartition::effPartition(const ChromSizesExt& cSizes, ss_id ssCnt, UINT limMult)
 {
 	IdNumbers numbs(cSizes);
+	numb_batches batches;
+	const numb_id maxID = numbs.size() ? numbs.MaxID() : 0;
+
+	// many small numbers (scaffolds, contigs) are distributed by batches:
+	// it keeps the partition accurate while limiting its cost and the recursion depth
+	if(ssCnt > 1)	numbs.Pack(batches, ssCnt);
 	Init(numbs, ssCnt, limMult);
+	if(batches.size()) {
+		result.Unpack(batches);
+		numbIDWidth = DigitsCnt(maxID);
+	}
 }
 
 // Prints subsets
@@ -10,6 +10,7 @@ such that the difference between the subset sums is minimized.
 
 #pragma once
 #include <vector>
+#include <map>
 #include <algorithm>    // sort
 #include "Data.h"		// ChromFiles
 
@@ -66,6 +67,7 @@ public:
 	typedef std::vector<IdNumber>::const_iterator numb_cit;
 	typedef std::vector<numb_id> numb_ids;
 	typedef std::vector<numb_id>::const_iterator numb_id_cit;
+	typedef std::map<numb_id, numb_ids> numb_batches;	// batch's head ID, batch's IDs
 
 	// Represents specialized container of identified numbers
 	class IdNumbers : public std::vector<IdNumber>
@@ -78,6 +80,9 @@ public:
 		// It is a heuristic value provides satisfactory inaccuracy in a single pass in most of cases
 		static const int minTol = 20;
 
+		// number of batches per subset: numbers beyond this count are packed
+		static const int BatchPerSubset = 16;
+
 		inline IdNumbers() {}
 
 		// Constructor by chrom sizes
@@ -106,6 +111,13 @@ public:
 
 		// Marks all numbers as unallocated
 		void Reset();
+
+		// Packs small numbers into batches of approximately equal sum, keeping large numbers as is.
+		// Each batch is represented by its head (first) number with the total batch value.
+		// Has no effect if the count of numbers does not exceed ssCnt * BatchPerSubset.
+		//	@batches: packed batches to be filled
+		//	@ssCnt: count of subsets
+		void Pack(numb_batches& batches, ss_id ssCnt);
 	};
 
 	// Represents partition
@@ -197,6 +209,10 @@ private:
 		//	@ascend: if true then in in ascending order, otherwise in descending order
 		void Sort(bool ascend);
 
+		// Replaces batch heads by batch's number IDs in each subset
+		//	@batches: packed batches
+		void Unpack(const numb_batches& batches);
+
 		// Prints sorted in descending order instance
 		//	@valW: maximum number value width (count of digits) to align vals right
 		//	@prNumbsCnt: maximum count of printed number IDs or 0 if all (by default)
@@ -19,6 +19,8 @@ Ensembl hg38 genome:	ftp://ftp.ensembl.org/pub/release-100/fasta/homo_sapiens/dn
 
 #include "isChIP.h"
 #include "Imitator.h"
+#include <thread>
+#include <condition_variable>
 
 using namespace std;
 
@@ -34,7 +36,9 @@ const string OutFileTip = "location of output files or existing folder\n[TEST mo
 // --smode option
 const char* smodes[] = { "SE","PE" };						// corresponds to OutFile::eMode
 // --format option: format notations
-const char* formats[] = { "FQ","BED","SAM","BG","FDENS","RDENS","FDIST","RDIST" };	// corresponds to Output::oFormat	
+const char* formats[] = { "FQ","BED","SAM","BG","FDENS","RDENS","FDIST","RDIST","REC" };	// corresponds to Output::oFormat	
+// --dens-step option
+const char* steps[] = { "VAR","FIX" };
 // --verbose option: verbose notations
 const char* verbs[] = { "SL","RES","RT","PAR","DBG" };
 // --ground option
@@ -80,6 +84,10 @@ If the option is not specified, ChIP-exo is not applied", NULL },
 	{ 'a',"pcr",	fNone,	tINT,	gTREAT, 0, 0, 500, NULL, "number of PCR cycles", NULL },
 	{ 'c',Chrom::Abbr,fNone,tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
 	"generate output for the specified chromosome only", NULL },
+	{ HPH, "region",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"generate output for the stated regions <chr:start-end[,...]> only", NULL },
+	{ HPH, "regions",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"generate output for the regions from the stated BED file only", NULL },
 	{ HPH,"bg-all",	fNone,	tENUM,	gTREAT, TRUE, 0, 2, (char*)Options::Booleans,
 	"turn on/off generation background for all chromosomes.\n", ForTest },
 	//{ HPH, "bind-len", fNone,	tINT,	gTREAT, 1, 1, 100, NULL, "minimum binding length.", ForTest },
@@ -94,8 +102,32 @@ If the option is not specified, ChIP-exo is not applied", NULL },
 	{ 'N', "full-gen",	fNone,	tENUM,	gTREAT, FALSE, vUNDEF, 2, NULL,
 	"process the entire reference chromosomes (including marginal gaps)", NULL },
 	{ 'P',"threads",fNone,	tINT,	gTREAT, 1, 1, 20, NULL, "number of threads", NULL },
+	{ HPH, "pin",	fNone,	tENUM,	gTREAT, FALSE,	vUNDEF, 2, NULL,
+	"pin threads to CPUs alternately over NUMA nodes, physical cores first", NULL },
+	{ HPH, "mem-limit",fAllow0,tINT,gTREAT, 0, 64, 1e7, NULL,
+	"memory limit in Mb: chromosomes are treated concurrently only as long as they fit,\n\
+I/O buffers and WIG data waiting for output are reduced. Value '0' means no limit", NULL },
+	{ HPH, "huge-pages",fNone,tENUM,gTREAT, FALSE,	vUNDEF, 2, NULL,
+	"back the threads chromosome buffers by transparent huge pages", NULL },
+	{ HPH, "reps",	fNone,	tINT,	gTREAT, 1, 1, 100, NULL,
+	"number of replicates generated in a single pass", NULL },
+	{ HPH, "shard",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"treat the stated shard <i/N> of chromosomes only", NULL },
 	{ HPH, "serv",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
 	"folder to store service files [-g|--gen]", NULL },
+	{ HPH, "prepare",fNone,	tENUM,	gTREAT, FALSE,	vUNDEF, 2, NULL,
+	"build service files for the whole reference genome using stated threads and exit.\n\
+Missing service files are also built before each simulation", NULL },
+	{ HPH, "jobs",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"run jobs from file, one option set per line, using stated threads and exit.\n\
+Other stated options are common for all jobs", NULL },
+#ifdef __unix__
+	{ HPH, "serve",	fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"run as a server accepting jobs through the stated unix socket, using stated threads.\n\
+Other stated options are common for all jobs", NULL },
+	{ HPH, "connect",fNone,	tNAME,	gTREAT, vUNDEF, 0, 0, NULL,
+	"run the job with other stated options on the server listening to the stated socket", NULL },
+#endif
 	{ HPH, "seed",	fNone,	tINT,	gTREAT, 0, 0, 1000, NULL,
 	"fix random emission with given seed, or 0 if don't fix", NULL },
 	{ 'o', "overl",	fNone,	tENUM,	gTEMPL, FALSE,	0, 2, (char*)Options::Booleans,
@@ -126,8 +158,28 @@ If the option is not specified, the read length is fixed", NULL },
 	(char*)formats,	"format of output data, in any order", NULL },
 	{ 'C',"control",fNone,	tENUM,	gOUTPUT, FALSE,	vUNDEF, 2, NULL,
 	"generate control simultaneously with test", NULL },
+	{ HPH,"tiers",	fNone,	tNAME,	gOUTPUT, vUNDEF, 0, 0, NULL,
+	"comma-separated list of nested depth tiers in percent, e.g. 10,25,50.\n\
+Each tier is a subset of the full output and of the deeper tiers", NULL },
 	{ 'x',"strand",	fNone,	tENUM,	gOUTPUT, FALSE,	vUNDEF, 2, NULL,
 	"generate two additional wig files, each one per strand", NULL },
+	{ HPH,"dens-bin",fNone,	tINT,	gOUTPUT, 1, 1, 1e5, NULL,
+	"bin length of density output (FDENS, RDENS)", NULL },
+	{ HPH,"dens-step",fNone,tENUM,	gOUTPUT, 0, 0, ArrCnt(steps), (char*)steps,
+	"density format: ? - variableStep, ? - fixedStep", NULL },
+	{ HPH,"wig-mem",fAllow0,tINT,	gOUTPUT, 512, 16, 1e6, NULL,
+	"memory limit in Mb for completed WIG data waiting for sorted output;\n\
+exceeding data is kept in temporary files. Value '0' means no limit", NULL },
+	{ HPH,"bigwig",	fNone,	tENUM,	gOUTPUT, FALSE,	vUNDEF, 2, NULL,
+	"write coverage and density (BG, FDENS, RDENS) in bigWig format", NULL },
+	{ HPH,"render",	fNone,	tNAME,	gOUTPUT, vUNDEF, 0, 0, NULL,
+	"render REC file into the stated formats and exit.\nTemplate is not required", NULL },
+	{ HPH,"merge",	fNone,	tINT,	gOUTPUT, 0, 0, 255, NULL,
+	"merge REC files of the stated number of shards, render them into the stated formats\nand exit", NULL },
+	{ HPH,"resume",	fNone,	tENUM,	gOUTPUT, FALSE,	vUNDEF, 2, NULL,
+	"journal completed chromosomes and resume an interrupted run.\nOutput formats are rendered from REC files", NULL },
+	{ HPH,"cache",	fNone,	tNAME,	gOUTPUT, vUNDEF, 0, 0, NULL,
+	"existing folder to keep generated chromosomes; the next runs reuse\nthe chromosomes with unchanged inputs", NULL },
 	{ 'O', sOutput,	fNone,	tNAME,	gOUTPUT, vUNDEF, 0, 0, NULL, OutFileTip.c_str()	},
 	{ 'T', "sep",	fNone,	tENUM,	gOUTPUT, FALSE,	vUNDEF, 2, NULL, "use 1000 separator in output", NULL },
 #ifndef _NO_ZLIB
@@ -148,17 +200,61 @@ const BYTE Options::UsageCount = ArrCnt(Options::Usages);
 
 // Returns common name of output files
 string GetOutFileName();
+
+vector<BYTE> GetTiers(const char* tiers);
+UINT GetShard(const char* shard, UINT& shardCnt);
+Imitator::Windows* GetWindows(ChromSizes& cSizes);
+string ShardSuffix(UINT shardNumb, UINT shardCnt);
+ULLONG MergeShards(const string& oName, UINT shardCnt, ChromSizesExt& cSizes, thrid thrCnt,
+	const string& cmLine);
+void PrepareResume(const Imitator::Journal& journal, const vector<string>& oNames);
+void RenderRecords(const vector<string>& oNames, int format, const ChromSizesExt& cSizes,
+	thrid thrCnt, const string& cmLine, bool control);
+string GenerationArgs(int argc, char* argv[], int fileInd);
+int RunJobs(const char* fName, int argc, char* argv[]);
+vector<string> CommonArgs(int argc, char* argv[]);
+#ifdef __unix__
+int Serve(const char* sockName, int argc, char* argv[]);
+int Connect(const char* sockName, int argc, char* argv[]);
+#endif
 void PrintParams(const ChromSizesExt& cSizes, const char* templName, const Features* templ, const Output& oFile);
 
 /*****************************************/
-int main(int argc, char* argv[])
+#ifndef _LIBISCHIP
+int main(int argc, char* argv[]) { return Simulate(argc, argv); }
+#endif
+
+// Runs the simulation by the command line arguments, as the program does
+//	return: 0 if success, otherwise 1
+int Simulate(int argc, char* argv[])
 {
 	int fileInd = Options::Parse(argc, argv);
 	if (fileInd < 0)	return 1;		// wrong option or tip output
+	if (Output::Sink)					// embedded run: records are passed in memory
+		for (int opt : { oJOBS, oMERGE, oRENDER, oTIERS, oSHARD, oRESUME, oCACHE, oPREPARE,
+#ifdef __unix__
+			oSERVE, oCONNECT,
+#endif
+		})
+			if (Options::Assigned(opt)) {
+				cerr << Options::OptionToStr(opt) << ": not allowed in the embedded run\n";
+				return 1;
+			}
 
 	int ret = 0;						// main() return code
 	Features* templ = NULL;
 	const char* fBedName = fileInd == argc ? NULL : argv[fileInd];	// template name
+	const char* recName = Options::GetSVal(oRENDER);	// rendered records file name
+
+	if (Options::GetSVal(oJOBS))		// batch mode; positional arguments are stated by jobs
+		return RunJobs(Options::GetSVal(oJOBS), fileInd, argv);
+#ifdef __unix__
+	if (Options::GetSVal(oCONNECT))		// client mode
+		return Connect(Options::GetSVal(oCONNECT), argc, argv);
+	const char* sockName = Options::GetSVal(oSERVE);	// server socket name
+#else
+	const char* sockName = NULL;
+#endif
 
 	// initialize Seq before Read::Init()
 	Seq::Init(Options::GetIVal(oSMODE), ULONG(Options::GetFVal(oRD_LIMIT)));
@@ -176,15 +272,19 @@ int main(int argc, char* argv[])
 		rdd.Values(), Options::Assigned(oRD_DIST)
 	);
 	Output::Init(
-		Options::GetIVal(oFORMAT),
+		Options::GetIVal(oFORMAT) & (recName ? ~int(Output::eFormat::REC) : ~0),	// don't rewrite rendered records
 		Options::GetUIVal(oMAP_QUAL),
 		Options::GetBVal(oSTRAND),
 		Options::GetFVal(oSTRAND_ERR) / 100,
 #ifdef _NO_ZLIB
-		false
+		false,
 #else
-		Options::GetBVal(oGZIP)
+		Options::GetBVal(oGZIP),
 #endif
+		Options::GetUIVal(oDENS_BIN),
+		Options::GetIVal(oDENS_STEP) == 1,
+		Options::GetUIVal(oWIG_MEM),
+		Options::GetBVal(oBIGWIG)
 	);
 	Imitator::Init(
 		fBedName != NULL ? TEST : CONTROL,	// fBedName should be set
@@ -199,7 +299,8 @@ int main(int argc, char* argv[])
 		//!Options::GetBVal(oBS_SCORE),
 		//readlen(Options::GetUIVal(oBS_LEN)),
 		//flattens.Values()
-		Options::GetUIVal(oFLAT_LEN)
+		Options::GetUIVal(oFLAT_LEN),
+		BYTE(Options::GetUIVal(oREPS))
 	);
 	RefSeq::LetGaps = Options::GetBVal(oLET_GAPS);
 	RefSeq::StatGaps = Imitator::Verbose(eVerb::PAR);		// Imitator::Init() should be called before
@@ -208,6 +309,11 @@ int main(int argc, char* argv[])
 
 	// execution
 	Mutex::Init(Options::GetIVal(oNUMB_THREAD) > 1);
+	if (Options::GetBVal(oPIN))	Affinity::Init();
+	else						Affinity::Reset();
+	Imitator::MemLimit = size_t(Options::GetUIVal(oMEM_LIMIT)) << 20;
+	TxtFile::ResetCloneBuffLen();
+	SeqArena::HugePages = Options::GetBVal(oHUGE_PAGES);
 	Timer::Enabled = Options::GetBVal(oTIME) && Imitator::Verbose(eVerb::RES);
 	Timer::StartCPU();
 	Timer timer;
@@ -215,43 +321,153 @@ int main(int argc, char* argv[])
 		// check file names first of all
 		FS::CheckedFileName(fBedName);
 		Output::SetReadQualPatt(FS::CheckedFileName(oRD_QUAL_PATT));	// read quality pattern file name
+		Output::SetTiers(GetTiers(Options::GetSVal(oTIERS)));
+		if (Options::GetSVal(oTIERS)) {		// tiers are not rendered from REC files
+			if (Options::GetBVal(oRESUME))			Err("cannot be combined with --tiers", "--resume").Throw();
+			else if (Options::GetSVal(oCACHE))		Err("cannot be combined with --tiers", "--cache").Throw();
+			else if (Options::GetSVal(oSHARD))		Err("cannot be combined with --tiers", "--shard").Throw();
+			else if (Options::GetUIVal(oMERGE))	Err("cannot be combined with --tiers", "--merge").Throw();
+		}
+		FS::CheckedDirName(oCACHE);
+		UINT shardCnt;
+		const UINT shardNumb = GetShard(Options::GetSVal(oSHARD), shardCnt);
 
 		ChromSizesExt cSizes(
 			Options::GetSVal(oGEN), oCHROM, Imitator::Verbose(eVerb::RT), Options::GetSVal(oSERV));
+		const thrid thrCnt = thrid(Options::GetFVal(oNUMB_THREAD));
+
+		if (Options::GetBVal(oPREPARE) || sockName) {	// build service files only
+			cSizes.Prepare(thrCnt, true, Imitator::Verbose(eVerb::RES));
+#ifdef __unix__
+			if (sockName)	ret = Serve(sockName, fileInd, argv);	// server mode
+#endif
+		}
+		else if (Options::GetUIVal(oMERGE)) {	// merge shards only
+			const ULLONG rCnt = MergeShards(GetOutFileName(), Options::GetUIVal(oMERGE), cSizes, thrCnt,
+				Options::CommandLine(argc, argv));
+			if (Imitator::Verbose(eVerb::RES))
+				cout << rCnt << SPACE << Read::title << " records merged\n";
+		}
+		else if (recName) {					// render records only
+			const RecInFile recFile(recName);
+			if (recFile.IsPE() != Seq::IsPE() || recFile.ReadLen() != Read::FixedLen
+			|| recFile.IsRVL() != DistrParams::IsRVL())
+				Err(string("records are generated in ") + (recFile.IsPE() ? "PE" : "SE") + " mode with "
+					+ (recFile.IsRVL() ? "variable " : "fixed ") + Read::title + " length "
+					+ to_string(recFile.ReadLen()) + "; set the same options", recName).Throw();
+			if (!cSizes.SetTreated(recFile.ChromIDs()))
+				Err(Err::TF_EMPTY, recName, "records per stated " + Chrom::ShortName(Chrom::CustomID()))
+				.Throw();
+			cSizes.Prepare(thrCnt, false, false);
+			Imitator::SetThreadNumb(min(chrid(thrCnt), cSizes.TreatedCount()));	// before Output creation
 
-		if (fBedName) {
-			//Obj::Ambig::SetSupplAlarm(Obj::Ambig::SHORT, "for given binding Imitator::FlatLenlength");
-			templ = new Features(fBedName, cSizes,
-				Options::GetBVal(oOVERL),
-				Options::GetIVal(oBS_SCORE),
-				0, //readlen(Options::GetUIVal(oBS_LEN)),		// binding length
-				true											// print name
-				//Imitator::Verbose(eVerb::DBG)						// print ambigs alarm
-			);
-			//templ->Print();
-			//if(flattens.Values().second)
-			//	templ->Extend(flattens.Values().second, cSizes, Obj::iLAC);
-			//templ->Extend(10000, cSizes, Obj::iSTAT);
-
-			chrlen halfMinFLen = templ->GetMinFeatureLength() / 2;
-			if (halfMinFLen < chrlen(Imitator::FlatLen)) {
-				Imitator::FlatLen = halfMinFLen;
-				if (Imitator::Verbose(eVerb::RT))
-					Err(UnstableBSLen + " reduced to " + to_string(halfMinFLen)
-						+ " due to minimum template feature length").Warning();
+			ULLONG rCnt;
+			{
+				Output oFile(GetOutFileName(), false, Options::CommandLine(argc, argv), cSizes);
+				if (Imitator::Verbose(eVerb::PAR))	oFile.PrintFormat(SignPar);
+				rCnt = oFile.Render(recFile, cSizes, thrCnt);
 			}
+			if (Imitator::Verbose(eVerb::RES))
+				cout << rCnt << SPACE << Read::title << " records rendered\n";
 		}
+		else {
+			if (fBedName) {
+				//Obj::Ambig::SetSupplAlarm(Obj::Ambig::SHORT, "for given binding Imitator::FlatLenlength");
+				templ = new Features(fBedName, cSizes,
+					Options::GetBVal(oOVERL),
+					Options::GetIVal(oBS_SCORE),
+					0, //readlen(Options::GetUIVal(oBS_LEN)),		// binding length
+					true											// print name
+					//Imitator::Verbose(eVerb::DBG)						// print ambigs alarm
+				);
+				//templ->Print();
+				//if(flattens.Values().second)
+				//	templ->Extend(flattens.Values().second, cSizes, Obj::iLAC);
+				//templ->Extend(10000, cSizes, Obj::iSTAT);
 
-		// set treated chroms
-		if (!cSizes.SetTreated(Imitator::All, templ))
-			Err(Err::TF_EMPTY, fBedName, "features per stated " + Chrom::ShortName(Chrom::CustomID()))
-			.Throw();
+				chrlen halfMinFLen = templ->GetMinFeatureLength() / 2;
+				if (halfMinFLen < chrlen(Imitator::FlatLen)) {
+					Imitator::FlatLen = halfMinFLen;
+					if (Imitator::Verbose(eVerb::RT))
+						Err(UnstableBSLen + " reduced to " + to_string(halfMinFLen)
+							+ " due to minimum template feature length").Warning();
+				}
+			}
+
+			// set treated chroms
+			if (!cSizes.SetTreated(Imitator::All, templ))
+				Err(Err::TF_EMPTY, fBedName, "features per stated " + Chrom::ShortName(Chrom::CustomID()))
+				.Throw();
+			unique_ptr<Imitator::Windows> wins(GetWindows(cSizes));
+			if (wins) {				// treat chroms with windows only
+				vector<chrid> cIDs;
+				for (chrid cID : wins->ChromIDs()) {
+					const auto it = cSizes.GetIter(cID);
+					if (it != cSizes.cEnd() && cSizes.IsTreated(it))	cIDs.push_back(cID);
+				}
+				if (!cSizes.SetTreated(cIDs))
+					Err("no regions on the treated " + Chrom::Title(true),
+						Options::GetSVal(oREGION) ? "--region" : "--regions").Throw();
+				Imitator::Wins = wins.get();
+			}
+			cSizes.Prepare(thrCnt, false, false);
+			if (shardNumb) {		// treat shard's chroms only
+				if (shardCnt > cSizes.TreatedCount())
+					Err("number of shards exceeds the number of treated " + Chrom::TitleName(),
+						"--shard").Throw();
+				for (ChromSizes::cIter it = cSizes.cBegin(); it != cSizes.cEnd(); it++)
+					if (cSizes.IsTreated(it))	Imitator::ShardedIDs.push_back(CID(it));
+				// the length-based partition doesn't depend on the timing, so it is the same in each shard
+				vector<chrid> cIDs = effPartition(cSizes, thrid(shardCnt))[shardNumb - 1].NumbIDs();
+				sort(cIDs.begin(), cIDs.end());
+				cSizes.SetTreated(cIDs);
+			}
 
-		Imitator::SetThreadNumb(min(chrid(Options::GetFVal(oNUMB_THREAD)), cSizes.TreatedCount()));
-		Output oFile(GetOutFileName(), Imitator::IsControl(), Options::CommandLine(argc, argv), cSizes);
+			// Test and Control of each chrom may be treated by separate threads
+			Imitator::SetThreadNumb(thrid(min(size_t(thrCnt),
+				size_t(cSizes.TreatedCount()) << int(Imitator::IsControl()))));
+			const string oName = GetOutFileName() + (shardNumb ? ShardSuffix(shardNumb, shardCnt) : strEmpty);
+			const string cmLine = Options::CommandLine(argc, argv);
+			const int format = Output::GetFormat();	// user-stated formats
+			vector<string> oNames;					// common names of output files of each replicate
+			for (BYTE r = 1; r <= Imitator::RepCnt; r++)
+				oNames.push_back(Imitator::RepCnt > 1 ? oName + "_rep" + to_string(r) : oName);
+			unique_ptr<Imitator::Journal> journal;	// journal of completed chroms in resume mode
+			if (Options::GetBVal(oRESUME)) {
+				string key;		// arguments except threads, which don't affect the result
+				for (const string& arg : CommonArgs(argc, argv))	key += arg + SPACE;
+				journal.reset(new Imitator::Journal(oName, key));
+				PrepareResume(*journal, oNames);
+			}
+			unique_ptr<Imitator::Cache> cache;		// cache of chroms
+			if (Options::GetSVal(oCACHE)) {
+				if (!Options::GetUIVal(oSEED) && Imitator::Verbose(eVerb::CRIT))
+					Err("random seed is not fixed; cached chromosomes repeat the previous runs", "--cache").Warning();
+				cache.reset(new Imitator::Cache(Options::GetSVal(oCACHE), GenerationArgs(argc, argv, fileInd)));
+				Imitator::Cch = cache.get();
+			}
+			// the stated formats are rendered from the REC files at the end, or by merging the shards
+			if (journal || cache || shardNumb)
+				Output::SetFormat(int(Output::eFormat::REC));
+			vector<unique_ptr<Output>> oFiles;		// output files of each replicate
+			for (BYTE r = 0; r < oNames.size(); r++)
+				oFiles.emplace_back(new Output(oNames[r], Imitator::IsControl(), cmLine, cSizes, r));
 
-		PrintParams(cSizes, fBedName, templ, oFile);
-		Imitator(cSizes, oFile).Execute(templ);
+			PrintParams(cSizes, fBedName, templ, *oFiles[0]);
+			if (journal && Imitator::Verbose(eVerb::PAR)) {
+				cout << SignPar << "Resume journal" << SepCl << journal->FileName();
+				if (journal->Count())	cout << SepCm << journal->Count() << " completed";
+				cout << LF;
+			}
+			Imitator(cSizes, oFiles).Execute(templ);
+			if (journal || cache || shardNumb) {
+				oFiles.clear();						// close REC files
+				if (cache)		cache->Assemble(oNames);
+				if (!shardNumb)
+					RenderRecords(oNames, format, cSizes, thrCnt, cmLine, Imitator::IsControl());
+				if (journal)	journal->Remove();
+			}
+		}
 	}
 	catch (Err & e) { ret = 1; cerr << e.what() << LF; }
 	catch (const exception & e) { ret = 1; cerr << e.what() << LF; }
@@ -277,7 +493,15 @@ void PrintParams(const ChromSizesExt& cSizes, const char* templName,
 	else 
 		cSizes.PrintTreatedChroms();
 	cout << LF;
+	if (Options::GetSVal(oSHARD)) {
+		cout << SignPar << "Shard " << Options::GetSVal(oSHARD) << SepCl << Chrom::TitleName() << COLON;
+		cSizes.PrintTreatedChroms();
+		cout << LF;
+	}
 
+	if (Imitator::Wins)
+		cout << SignPar << "Regions" << SepCl << Imitator::Wins->Count() << SepSCl
+			<< "margin" << Equel << Imitator::Windows::Margin() << LF;
 	if (!cSizes.IsServAsRef())
 		cout << SignPar << "Service folder" << SepCl << cSizes.ServPath() << LF;
 
@@ -289,6 +513,9 @@ void PrintParams(const ChromSizesExt& cSizes, const char* templName,
 		else	cout << "score index" << Equel << Options::GetIVal(oBS_SCORE) << LF;
 	}
 	oFile.PrintFormat(SignPar);		// print output formats, sequencing mode
+	if (Imitator::RepCnt > 1)
+		cout << SignPar << "Replicates" << SepCl << int(Imitator::RepCnt)
+			<< ", output of each one is suffixed by '_rep<N>'\n";
 	Seq::Print(SignPar);			// print sequencing modes
 	cout << SignPar << "Sequencing modification" << SepCl << "ChIP-";
 	if (Imitator::IsExo)
@@ -302,6 +529,8 @@ void PrintParams(const ChromSizesExt& cSizes, const char* templName,
 	DistrParams::PrintReadDistr(cout, SignPar, Read::Title);
 	cout << SignPar << "Optimization: process the entire ref. " << Chrom::Title()
 		<< SepCl << Options::BoolToStr(oLET_GAPS) << LF;
+	if (Output::IsSeqFree())
+		cout << SignPar << "Optimization: sequence-free (nucleotides are not loaded)\n";
 	cout << SignPar << "Stated sample: ";
 	if (TestMode) {
 		cout << "foreground" << Equel << SAMPLE_FG()
@@ -325,9 +554,788 @@ void PrintParams(const ChromSizesExt& cSizes, const char* templName,
 		<< SepCl << ws << PERS << LF;
 	if (!Imitator::IsSingleThread())
 		cout << SignPar << "Actual threads" << SepCl << int(Imitator::ThrCnt) << LF;
+	Affinity::Print(SignPar, Imitator::ThrCnt);
+	if (Imitator::MemLimit)
+		cout << SignPar << "Memory limit" << SepCl << (Imitator::MemLimit >> 20) << " Mb\n";
 	DistrParams::PrintFragDistr(cout, SignPar, true);
 }
 
+#ifdef OS_Windows
+#define popen	_popen
+#define pclose	_pclose
+#define PATH_MAX	_MAX_PATH
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#endif
+
+// Splits the line into arguments separated by blanks; double-quoted argument may contain blanks
+//	@line: arguments line
+//	return: arguments
+vector<string> SplitArgs(const string& line)
+{
+	vector<string> args;
+
+	for (size_t i = 0; i < line.size();) {
+		if (isblank(line[i]))	{ i++; continue; }
+		string arg;
+		for (bool quoted = false; i < line.size() && (quoted || !isblank(line[i])); i++)
+			if (line[i] == '"')	quoted = !quoted;
+			else				arg += line[i];
+		args.push_back(arg);
+	}
+	return args;
+}
+
+// 'Job' keeps one batch run
+struct Job
+{
+	size_t	LineNumb;	// number of line in jobs file
+	string	Args;		// job's options
+	vector<string> ArgList;	// job's options split into arguments
+	ULONG	Cost = 1;	// estimated cost: cells * replicates * (control + 1)
+	thrid	ThrCnt = 1;	// job's number of threads
+
+	// Creates job and estimates its cost by the job's options
+	//	@lineNumb: number of line in jobs file
+	//	@args: job's options
+	Job(size_t lineNumb, const string& args) : LineNumb(lineNumb), Args(args), ArgList(SplitArgs(args))
+	{
+		for (size_t i = 0; i < ArgList.size(); i++) {
+			const string& opt = ArgList[i];
+			if (opt == "-C" || opt == "--control") {
+				Cost *= 2;
+				continue;
+			}
+			const bool isCells = opt == "-n" || opt == "--cells";
+			const bool isReps = opt == "--reps";
+			const bool isThreads = opt == "-P" || opt == "--threads";
+			if (!(isCells || isReps || isThreads) || i + 1 == ArgList.size())	continue;
+			const ULONG v = max(1L, atol(ArgList[++i].c_str()));
+			if (isThreads)	ThrCnt = thrid(v);
+			else			Cost *= v;
+		}
+	}
+
+	// for sorting by cost descent
+	inline bool operator < (const Job& job) const { return job.Cost < Cost; }
+};
+
+// 'ThrBudget' shares the stated number of threads between concurrent jobs.
+// Each thread is represented by its slot, so concurrent jobs can be pinned to different CPUs.
+class ThrBudget
+{
+	vector<bool> _busy;		// true for each occupied slot
+	thrid	_freeCnt;		// number of free slots
+	mutex	_lock;
+	condition_variable _freed;
+
+public:
+	const thrid	Count;		// total number of threads
+
+	// Constructor by total number of threads
+	ThrBudget(thrid cnt) : _busy(cnt), _freeCnt(cnt), Count(cnt) {}
+
+	// Waits until the job's threads become free and occupies them
+	//	@cnt: job's number of threads
+	//	return: occupied slots
+	vector<thrid> Take(thrid cnt)
+	{
+		vector<thrid> slots;
+		cnt = min(cnt, Count);
+		unique_lock<mutex> ul(_lock);
+		_freed.wait(ul, [&] { return _freeCnt >= cnt; });
+		_freeCnt -= cnt;
+		for (thrid i = 0; slots.size() < cnt; i++)
+			if (!_busy[i])	_busy[i] = true, slots.push_back(i);
+		return slots;
+	}
+
+	// Releases occupied threads
+	//	@slots: occupied slots
+	void Release(const vector<thrid>& slots)
+	{
+		lock_guard<mutex> lg(_lock);
+		for (thrid i : slots)	_busy[i] = false;
+		_freeCnt += thrid(slots.size());
+		_freed.notify_all();
+	}
+};
+
+// Returns main arguments common to all jobs: all but batch options and threads with their values
+//	@argc: count of main arguments to be examined
+//	@argv: main arguments
+vector<string> CommonArgs(int argc, char* argv[])
+{
+	static const char* skipped[] = { "--jobs", "--serve", "-P", "--threads" };
+	vector<string> args;
+
+	for (int i = 1; i < argc; i++)
+		if (find_if(begin(skipped), end(skipped),
+			[&](const char* opt) { return !strcmp(opt, argv[i]); }) != end(skipped))
+			i++;		// skip with value
+		else
+			args.push_back(argv[i]);
+	return args;
+}
+
+// Returns common arguments, excluding options (with their values) overridden by job's arguments
+//	@common: common arguments
+//	@job: job's arguments
+vector<string> CommonArgs(const vector<string>& common, const vector<string>& job)
+{
+	vector<int> jobOpts;		// job's options indexes
+	vector<string> args;
+	bool skip = false;			// true if current common option is overridden
+
+	for (const string& arg : job)
+		jobOpts.push_back(Options::OptIndex(arg.c_str()));
+	for (const string& arg : common) {
+		const int opt = Options::OptIndex(arg.c_str());
+		if (opt >= 0)	skip = find(jobOpts.begin(), jobOpts.end(), opt) != jobOpts.end();
+		if (!skip)		args.push_back(arg);
+	}
+	return args;
+}
+
+// Returns absolute path to the running executable
+//	@argv0: the first main argument
+string ExePath(const char* argv0)
+{
+	char exe[PATH_MAX];
+#ifdef __linux__
+	const ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len > 0)	return string(exe, len);
+#endif
+#ifdef OS_Windows
+	if (_fullpath(exe, argv0, sizeof(exe)))	return exe;
+#else
+	if (realpath(argv0, exe))	return exe;
+#endif
+	return argv0;
+}
+
+// Runs the program and collects its output
+//	@args: program's arguments, starting with the executable path; no shell is involved
+//	@out: collected standard output and error
+//	@cpus: CPUs allowed to the program, or empty to inherit them; Linux only
+//	return: program's exit code, or -1 if it cannot be run
+int RunProcess(const vector<string>& args, string& out, const vector<int>& cpus)
+{
+	char buff[1024];
+#ifdef OS_Windows
+	string cmLine;
+	for (const string& arg : args)	cmLine += '"' + arg + "\" ";
+	FILE* pipe = popen((cmLine + "2>&1").c_str(), "r");
+	if (!pipe)	return -1;
+	for (size_t n; (n = fread(buff, 1, sizeof(buff), pipe)) > 0;)
+		out.append(buff, n);
+	return pclose(pipe);
+#else
+	static mutex forkLock;	// keeps the pipe from leaking to the processes forked by other threads
+	vector<char*> argv;
+	for (const string& arg : args)	argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(NULL);
+
+#ifdef __linux__
+	cpu_set_t mask;		// prepared before fork: the child calls async-signal-safe functions only
+	CPU_ZERO(&mask);
+	for (int c : cpus)	CPU_SET(c, &mask);
+#endif
+	int fds[2];
+	pid_t pid;
+	{
+		lock_guard<mutex> lock(forkLock);
+		if (pipe(fds))	return -1;
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		if (!(pid = fork())) {		// job process; async-signal-safe calls only
+			dup2(fds[1], STDOUT_FILENO);
+			dup2(fds[1], STDERR_FILENO);
+#ifdef __linux__
+			if (cpus.size())	sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+			execv(argv[0], argv.data());
+			_exit(127);
+		}
+	}
+	close(fds[1]);
+	if (pid > 0)
+		for (ssize_t n; (n = read(fds[0], buff, sizeof(buff))) > 0;)
+			out.append(buff, n);
+	close(fds[0]);
+	int status;
+	return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// Runs jobs concurrently, each one as a separate isChIP process.
+// Service files and fragment averages are shared between jobs through the service folder.
+// In pinning mode each job is restricted to the CPUs of its own thread slots,
+// so the threads of concurrent jobs are pinned to different CPUs.
+//	@fName: jobs file name, one set of options per line
+//	@argc: count of main options, i.e. index of the first positional argument
+//	@argv: main arguments; all options but --jobs and --threads are common to all jobs
+//	return: 0 if all jobs succeeded, otherwise 1
+int RunJobs(const char* fName, int argc, char* argv[])
+{
+	ifstream file(fName);
+	if (!file.is_open()) {
+		cerr << Err(Err::F_OPEN, fName).what() << LF;
+		return 1;
+	}
+	const vector<string> common = CommonArgs(argc, argv);
+	vector<Job> jobs;
+	size_t lineNumb = 0;
+	for (string line; getline(file, line);) {
+		lineNumb++;
+		if (line.size() && line.back() == '\r')	line.pop_back();
+		if (line.find_first_not_of(" \t") != string::npos && line[line.find_first_not_of(" \t")] != '#')
+			jobs.emplace_back(lineNumb, line);
+	}
+	// the most costly jobs are started first to balance the load (LPT scheduling)
+	stable_sort(jobs.begin(), jobs.end());
+
+	const bool verb = Options::GetUIVal(oVERB) >= UINT(eVerb::RES);
+	const string exe = ExePath(argv[0]);
+	ThrBudget budget(thrid(Options::GetFVal(oNUMB_THREAD)));
+	if (Options::GetBVal(oPIN))	Affinity::Init();
+	else						Affinity::Reset();
+	size_t	failCnt = 0;
+	mutex	lock;
+	vector<thread> threads;
+	threads.reserve(jobs.size());
+
+	auto run = [&](const Job& job, const vector<thrid>& slots) {
+		// job's arguments: common ones, overridden by job's ones
+		vector<string> args(1, exe);
+		for (const string& arg : CommonArgs(common, job.ArgList))	args.push_back(arg);
+		args.insert(args.end(), job.ArgList.begin(), job.ArgList.end());
+		vector<int> cpus;
+		if (Affinity::IsSet())
+			for (thrid i : slots)	cpus.push_back(Affinity::CPU(i));
+		string out;
+		const int ret = RunProcess(args, out, cpus);
+		{
+			lock_guard<mutex> lg(lock);
+			if (ret)	failCnt++;
+			if (verb || ret) {
+				cout << "job " << fName << COLON << job.LineNumb << SepCl << job.Args << LF << out;
+				if (ret)	cout << "job " << fName << COLON << job.LineNumb << " failed\n";
+				fflush(stdout);
+			}
+		}
+		budget.Release(slots);
+	};
+
+	for (const Job& job : jobs)
+		threads.emplace_back(run, ref(job), budget.Take(job.ThrCnt));
+	for (thread& t : threads)	t.join();
+	if (verb)
+		cout << jobs.size() - failCnt << " of " << jobs.size() << " jobs completed successfully\n";
+	return failCnt ? 1 : 0;
+}
+
+#ifdef __unix__
+// Writes data to the socket entirely
+//	@fd: socket descriptor
+//	@data: written data
+//	@len: length of data
+//	return: false if the socket is closed
+bool SendAll(int fd, const char* data, size_t len)
+{
+	for (ssize_t n; len; data += n, len -= n)
+		if ((n = write(fd, data, len)) <= 0)	return false;
+	return true;
+}
+
+// Opens unix stream socket with given name
+//	@sockName: socket file name
+//	@addr: socket address to fill
+//	return: socket descriptor
+int OpenSocket(const char* sockName, sockaddr_un& addr)
+{
+	if (strlen(sockName) >= sizeof(addr.sun_path))
+		Err("socket name is too long", sockName).Throw();
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, sockName);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)		Err(strerror(errno), sockName).Throw();
+	return fd;
+}
+
+static volatile sig_atomic_t StopServer = 0;	// true if server is stopped by signal
+
+// Sets server stop flag; termination signal handler
+void OnStopSignal(int) { StopServer = 1; }
+
+// Runs server accepting job requests from clients through unix socket.
+// The jobs are run in the server process one at a time, each one in the client's working directory,
+// with its output streamed back to the client.
+// The loaded chromosomes are kept in memory between the jobs, so the jobs don't read the reference again;
+// service files of the whole genome are built before, so the jobs share them with the calibration.
+// Server is stopped by SIGINT, SIGTERM or SIGHUP: the running job is completed, queued ones are refused,
+// and the socket file is removed.
+//	@sockName: socket file name
+//	@argc: count of main options, i.e. index of the first positional argument
+//	@argv: main arguments; all options but --serve and --threads are common to all jobs
+//	return: 0 if server is stopped normally, otherwise 1
+int Serve(const char* sockName, int argc, char* argv[])
+{
+	const vector<string> common = CommonArgs(argc, argv);
+	const bool verb = Options::GetUIVal(oVERB) >= UINT(eVerb::RES);
+	const thrid thrCnt = thrid(Options::GetFVal(oNUMB_THREAD));
+	char	cwd[PATH_MAX];	// server's working directory, restored after each job
+	size_t	jobCnt = 0;
+	size_t	activeCnt = 0;	// number of connections in process
+	mutex	runLock;		// the generator keeps its state in static members, so jobs are run one at a time
+	mutex	cntLock;
+	condition_variable	completed;
+	sockaddr_un addr;
+
+	if (!getcwd(cwd, sizeof(cwd)))	Err(strerror(errno)).Throw();
+	// the socket file of a live server is kept, the one left by a terminated server is replaced
+	struct stat st;
+	if (!lstat(sockName, &st) && S_ISSOCK(st.st_mode)) {
+		const int probe = OpenSocket(sockName, addr);
+		const bool live = !connect(probe, (sockaddr*)&addr, sizeof(addr));
+		close(probe);
+		if (live)	Err("another server is listening to the socket", sockName).Throw();
+		unlink(sockName);
+	}
+	const int sock = OpenSocket(sockName, addr);
+	const mode_t mask = umask(0177);	// the socket is accessible to the owner only
+	const bool bound = !bind(sock, (sockaddr*)&addr, sizeof(addr));
+	umask(mask);
+	if (!bound || listen(sock, SOMAXCONN)) {
+		const string msg = strerror(errno);
+		close(sock);
+		if (bound)	unlink(sockName);
+		Err(msg, sockName).Throw();
+	}
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = OnStopSignal;
+	for (int sig : { SIGINT, SIGTERM, SIGHUP })	sigaction(sig, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);	// client can disconnect before the job is completed
+	StopServer = 0;
+	Imitator::Resident::On = true;
+	if (verb)	cout << "Listening to " << sockName << LF << flush;
+
+	// request: client's working directory and job's options, one per line, ended by empty line;
+	// reply: job's output, then '\0' and job's exit code
+	auto run = [&](int conn, size_t jobNumb) {
+		string req;
+		char buff[1024];
+		for (ssize_t n; req.find("\n\n") == string::npos && (n = read(conn, buff, sizeof(buff))) > 0;)
+			req.append(buff, n);
+		vector<string> lines;
+		istringstream ss(req.substr(0, req.find("\n\n")));
+		for (string line; getline(ss, line);)	lines.push_back(line);
+		BYTE code = 1;
+
+		if (req.find("\n\n") != string::npos && lines.size()) {
+			// job's arguments: common ones, overridden by client's ones; threads don't exceed the server's ones
+			vector<string> jobArgs;
+			string jobLine;
+			thrid jobThrCnt = thrCnt;
+			for (auto it = lines.begin() + 1; it != lines.end(); it++) {
+				jobLine += *it + SPACE;
+				if ((*it == "-P" || *it == "--threads") && it + 1 != lines.end())
+					jobThrCnt = thrid(min(max(1L, atol((++it)->c_str())), long(thrCnt))),
+					jobLine += *it + SPACE;
+				else
+					jobArgs.push_back(*it);
+			}
+			vector<string> args(1, Product::Title);
+			for (const string& arg : CommonArgs(common, jobArgs))	args.push_back(arg);
+			args.push_back("-P");
+			args.push_back(to_string(jobThrCnt));
+			args.insert(args.end(), jobArgs.begin(), jobArgs.end());
+			vector<char*> jobArgv;
+			for (string& arg : args)	jobArgv.push_back(&arg[0]);
+			jobArgv.push_back(NULL);
+
+			lock_guard<mutex> lock(runLock);
+			if (StopServer) {
+				static const char msg[] = "Error: server is stopped\n";
+				SendAll(conn, msg, sizeof(msg) - 1);
+			}
+			else {
+				if (verb)	cout << "job " << jobNumb << " started" << SepCl << jobLine << LF << flush;
+				// job's output goes to the client
+				fflush(stdout);
+				const int out = dup(STDOUT_FILENO), err = dup(STDERR_FILENO);
+				dup2(conn, STDOUT_FILENO);
+				dup2(conn, STDERR_FILENO);
+				if (chdir(lines[0].c_str()))
+					cerr << Err(strerror(errno), lines[0].c_str()).what() << LF;
+				else {
+					Options::Reset();
+					try { code = BYTE(Simulate(int(args.size()), jobArgv.data())); }
+					catch (...) { cerr << "Unregistered error\n"; }
+				}
+				cout.flush(), cerr.flush();
+				fflush(stdout), fflush(stderr);
+				cout.clear(), cerr.clear();			// the client may be disconnected
+				clearerr(stdout), clearerr(stderr);
+				dup2(out, STDOUT_FILENO), close(out);
+				dup2(err, STDERR_FILENO), close(err);
+				if (chdir(cwd)) {}
+				if (verb)	cout << "job " << jobNumb << (code ? " failed\n" : " completed\n") << flush;
+			}
+		}
+		const char reply[] = { '\0', char(code) };
+		SendAll(conn, reply, sizeof(reply));
+		close(conn);
+		lock_guard<mutex> lock(cntLock);
+		activeCnt--;
+		completed.notify_all();
+	};
+
+	int ret = 0;
+	for (pollfd pfd{ sock, POLLIN, 0 }; !StopServer;) {
+		if (poll(&pfd, 1, 500) <= 0)	continue;	// timeout or signal
+		const int conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)	continue;
+			cerr << Err(strerror(errno), sockName).what() << LF;
+			ret = 1;
+			break;
+		}
+		{
+			lock_guard<mutex> lock(cntLock);
+			activeCnt++;
+		}
+		thread(run, conn, ++jobCnt).detach();
+	}
+	close(sock);
+	unlink(sockName);
+	{
+		unique_lock<mutex> lock(cntLock);
+		completed.wait(lock, [&] { return !activeCnt; });
+	}
+	for (int sig : { SIGINT, SIGTERM, SIGHUP })	signal(sig, SIG_DFL);
+	Imitator::Resident::On = false;
+	Imitator::Resident::Clear();
+	if (verb)	cout << "Server stopped\n";
+	return ret;
+}
+
+// Runs job on the server and prints its output
+//	@sockName: server socket file name
+//	@argc: count of main arguments
+//	@argv: main arguments; all but --connect are passed to the server
+//	return: job's exit code
+int Connect(const char* sockName, int argc, char* argv[])
+{
+	char cwd[PATH_MAX];
+	sockaddr_un addr;
+	int sock = -1;
+
+	try {
+		if (!getcwd(cwd, sizeof(cwd)))	Err(strerror(errno)).Throw();
+		sock = OpenSocket(sockName, addr);
+		if (connect(sock, (sockaddr*)&addr, sizeof(addr)))
+			Err(strerror(errno), sockName).Throw();
+	}
+	catch (const Err& e) {
+		if (sock >= 0)	close(sock);
+		cerr << e.what() << LF;
+		return 1;
+	}
+	string req = string(cwd) + LF;
+	for (int i = 1; i < argc; i++)
+		if (strcmp(argv[i], "--connect"))	req += string(argv[i]) + LF;
+		else	i++;		// skip with value
+	req += LF;
+	signal(SIGPIPE, SIG_IGN);
+	if (!SendAll(sock, req.c_str(), req.size())) {
+		close(sock);
+		cerr << Err(strerror(errno), sockName).what() << LF;
+		return 1;
+	}
+
+	// stream output until the '\0' mark followed by exit code
+	int code = -1;
+	bool mark = false;
+	char buff[1024];
+	for (ssize_t n; code < 0 && (n = read(sock, buff, sizeof(buff))) > 0;)
+		for (ssize_t i = 0; i < n; i++) {
+			if (mark) {
+				code = BYTE(buff[i]);
+				break;
+			}
+			if (buff[i])	cout << buff[i];
+			else			mark = true;
+		}
+	cout << flush;
+	close(sock);
+	if (code < 0) {
+		cerr << Err("connection is broken", sockName).what() << LF;
+		return 1;
+	}
+	return code;
+}
+#endif
+
+// Returns nested depth tiers in ascending order, excluding full depth
+//	@tiers: comma-separated list of tiers in percent, or NULL
+vector<BYTE> GetTiers(const char* tiers)
+{
+	vector<BYTE> res;
+	if (!tiers)		return res;
+
+	istringstream ss(tiers);
+	for (string s; getline(ss, s, ',');) {
+		char* end;
+		const long pct = strtol(s.c_str(), &end, 10);
+		if (s.empty() || *end || pct < 1 || pct > 100)
+			Err("'" + s + "' is not a percentage from 1 to 100", "--tiers").Throw();
+		if (pct < 100)	res.push_back(BYTE(pct));
+	}
+	sort(res.begin(), res.end());
+	res.erase(unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+// Returns shard number stated as <i/N>, or 0 if shard is not stated
+//	@shard: stated shard, or NULL
+//	@shardCnt: number of shards to fill
+UINT GetShard(const char* shard, UINT& shardCnt)
+{
+	shardCnt = 0;
+	if (!shard)		return 0;
+
+	char* end;
+	const long numb = strtol(shard, &end, 10);
+	if (*end == '/')	shardCnt = UINT(strtol(end + 1, &end, 10));
+	if (*end || numb < 1 || shardCnt < UINT(numb) || shardCnt > UCHAR_MAX)
+		Err("'" + string(shard) + "' should be <i/N>, where 1 <= i <= N <= " + to_string(UCHAR_MAX),
+			"--shard").Throw();
+	return UINT(numb);
+}
+
+// Returns windows stated by --region and --regions, or NULL if none are stated
+//	@cSizes: chrom sizes
+Imitator::Windows* GetWindows(ChromSizes& cSizes)
+{
+	const char* rgns = Options::GetSVal(oREGION);
+	const char* bedName = Options::GetSVal(oREGIONS);
+	if (!rgns && !bedName)	return NULL;
+
+	unique_ptr<Imitator::Windows> wins(new Imitator::Windows);
+	if (rgns) {			// 1-based, inclusive as in genome browsers
+		istringstream ss(rgns);
+		string rgn;
+		while (getline(ss, rgn, ',')) {
+			const size_t pos = rgn.find(COLON);
+			chrid cID = Chrom::UnID;
+			ULONG start = 0, end = 0;
+			char* last = NULL;
+
+			if (pos != string::npos) {
+				const string chr = rgn.substr(0, pos);
+				const char* mark = Chrom::FindMark(chr.c_str());
+				cID = Chrom::ID(mark ? mark : chr.c_str());
+				start = strtoul(rgn.c_str() + pos + 1, &last, 10);
+				if (*last == HPH)	end = strtoul(last + 1, &last, 10);
+			}
+			if (cID == Chrom::UnID || !cSizes.FindChrom(cID)
+			|| *last || !start || end < start || end > cSizes[cID])
+				Err("'" + rgn + "' should be <chr:start-end> within the " + Chrom::Title(), "--region")
+				.Throw();
+			wins->Add(cID, Region(chrlen(start - 1), chrlen(end)));
+		}
+	}
+	if (bedName) {
+		const Features ftrs(FS::CheckedFileName(bedName), cSizes, true, 0, 0, false);
+
+		for (auto it = ftrs.cBegin(); it != ftrs.cEnd(); it++)
+			for (chrlen k = 0; k < ftrs.ItemsCount(it); k++)
+				wins->Add(CID(it), ftrs.Feature(it, k));
+	}
+	wins->Normalize();
+	return wins.release();
+}
+
+// Returns suffix of shard's output file names
+//	@shardNumb: shard number, 1-based
+//	@shardCnt: number of shards
+string ShardSuffix(UINT shardNumb, UINT shardCnt)
+{
+	return "_shard" + to_string(shardNumb) + "of" + to_string(shardCnt);
+}
+
+// Merges REC files of all shards into common ones and renders them into the stated formats,
+// so the output is the same as of the single run: the chroms are rendered in the same order
+// and the Read numbers are counted through all shards.
+// The shard files are removed after merging.
+//	@oName: common name of output files
+//	@shardCnt: number of shards
+//	@cSizes: chrom sizes
+//	@thrCnt: number of threads
+//	@cmLine: command line
+//	return: number of merged records
+ULLONG MergeShards(const string& oName, UINT shardCnt, ChromSizesExt& cSizes, thrid thrCnt,
+	const string& cmLine)
+{
+	vector<string> oNames;		// common names of merged output files of each replicate
+	vector<string> shardNames;	// shard REC files
+	vector<chrid> cIDs;			// chroms recorded by all shards
+	ULLONG rCnt = 0;
+
+	for (BYTE r = 1; r <= Imitator::RepCnt; r++)
+		oNames.push_back(Imitator::RepCnt > 1 ? oName + "_rep" + to_string(r) : oName);
+	// control is generated in test mode only, which is not known without the template
+	const bool control = FS::IsFileExist((oName + ShardSuffix(1, shardCnt)
+		+ oNames[0].substr(oName.size()) + "_input" + RecOutFile::Ext).c_str());
+	for (const string& name : oNames)
+		for (BYTE i = 0; i <= BYTE(control); i++) {
+			// shard suffix goes before the replicate and control ones
+			const string suffix = name.substr(oName.size()) + (i ? "_input" : strEmpty) + RecOutFile::Ext;
+			const string recName = oName + suffix;
+
+			for (UINT k = 1; k <= shardCnt; k++) {
+				const string shardName = oName + ShardSuffix(k, shardCnt) + suffix;
+				const RecInFile file(shardName);
+
+				if (file.IsPE() != Seq::IsPE() || file.ReadLen() != Read::FixedLen
+				|| file.IsRVL() != DistrParams::IsRVL())
+					Err(string("records are generated in ") + (file.IsPE() ? "PE" : "SE") + " mode with "
+						+ (file.IsRVL() ? "variable " : "fixed ") + Read::title + " length "
+						+ to_string(file.ReadLen()) + "; set the same options", shardName).Throw();
+				if (k == 1) {		// the first shard is copied with the header
+					ifstream in(shardName, ios::binary);
+					ofstream out(recName, ios::binary);
+					if (!(out << in.rdbuf()))	Err(Err::F_WRITE, recName.c_str()).Throw();
+				}
+				else	file.AppendTo(recName);
+				for (chrid cID : file.ChromIDs())	cIDs.push_back(cID);
+				shardNames.push_back(shardName);
+			}
+		}
+	sort(cIDs.begin(), cIDs.end());
+	cIDs.erase(unique(cIDs.begin(), cIDs.end()), cIDs.end());
+	if (!cSizes.SetTreated(cIDs))
+		Err(Err::TF_EMPTY, (oName + ShardSuffix(1, shardCnt) + RecOutFile::Ext).c_str(),
+			"records per stated " + Chrom::ShortName(Chrom::CustomID())).Throw();
+	cSizes.Prepare(thrCnt, false, false);
+	Imitator::SetThreadNumb(min(chrid(thrCnt), cSizes.TreatedCount()));	// before Output creation
+
+	for (const string& name : oNames)
+		rCnt += RecInFile(name + RecOutFile::Ext).Count();
+	RenderRecords(oNames, Output::GetFormat(), cSizes, thrCnt, cmLine, control);
+	for (const string& name : shardNames)	remove(name.c_str());
+	return rCnt;
+}
+
+#ifdef __unix__
+// Terminates interrupted run in resume mode; completed chroms are already journaled
+void OnInterrupt(int sig)
+{
+	static const char msg[] = "\nInterrupted; run the same command to resume\n";
+
+	if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) {}	// async-signal-safe output
+	_exit(128 + sig);
+}
+#endif
+
+// Prepares REC files of each replicate to resume generation:
+// drops the records of uncompleted chroms and switches output to REC appending
+//	@journal: journal of completed chroms
+//	@oNames: common names of output files of each replicate
+void PrepareResume(const Imitator::Journal& journal, const vector<string>& oNames)
+{
+	if (journal.Count())
+		for (BYTE r = 0; r < oNames.size(); r++) {
+			const vector<chrid> cIDs = journal.DoneIDs(r);
+
+			for (BYTE i = 0; i <= BYTE(Imitator::IsControl()); i++) {
+				const string name = i ? oNames[r] + "_input" : oNames[r];
+
+				if (FS::IsFileExist((name + RecOutFile::Ext).c_str()))
+					RecOutFile::Compact(name, cIDs);
+				else if (cIDs.size())
+					Err("records of the interrupted run are missing; remove "
+						+ journal.FileName() + " to start from scratch", name + RecOutFile::Ext).Throw();
+			}
+		}
+	RecOutFile::Resume = journal.Count();
+	Imitator::Jrnl = const_cast<Imitator::Journal*>(&journal);
+#ifdef __unix__
+	signal(SIGTERM, OnInterrupt);
+	signal(SIGINT, OnInterrupt);
+#endif
+}
+
+// Renders REC files of each replicate, generated in resume or cache mode, into the stated formats.
+// REC files are removed if REC format is not stated.
+//	@oNames: common names of output files of each replicate
+//	@format: user-stated output formats
+//	@cSizes: chrom sizes
+//	@thrCnt: number of threads
+//	@cmLine: command line
+//	@control: if true, then control REC files are rendered too
+void RenderRecords(const vector<string>& oNames, int format, const ChromSizesExt& cSizes,
+	thrid thrCnt, const string& cmLine, bool control)
+{
+	Output::SetFormat(format & ~int(Output::eFormat::REC));
+	for (const string& oName : oNames) {
+		const string recName = oName + RecOutFile::Ext;
+		const string ctrlRecName = oName + "_input" + RecOutFile::Ext;
+
+		if (Output::GetFormat()) {
+			const RecInFile recFile(recName);
+			unique_ptr<RecInFile> ctrlRecFile(control ? new RecInFile(ctrlRecName) : NULL);
+
+			Output(oName, control, cmLine, cSizes).Render(recFile, cSizes, thrCnt, ctrlRecFile.get());
+		}
+		if (!(format & int(Output::eFormat::REC))) {
+			remove(recName.c_str());
+			if (control)	remove(ctrlRecName.c_str());
+		}
+	}
+}
+
+// Returns arguments affecting the generation, separated by space:
+// all but the reference, template, regions (they are keyed per chrom), output and run control ones
+//	@argc: count of main arguments
+//	@argv: main arguments
+//	@fileInd: index of template argument
+string GenerationArgs(int argc, char* argv[], int fileInd)
+{
+	static const int skipped[] = { oGEN, oREGION, oREGIONS, oNUMB_THREAD, oPIN, oMEM_LIMIT, oHUGE_PAGES, oREPS, oSHARD, oSERV, oPREPARE, oJOBS,
+#ifdef __unix__
+		oSERVE, oCONNECT,
+#endif
+		oRD_NAME, oRD_LIMIT_N, oRD_QUAL, oRD_QUAL_PATT, oMAP_QUAL, oFORMAT, oTIERS, oSTRAND,
+		oDENS_BIN, oDENS_STEP, oWIG_MEM, oBIGWIG, oRENDER, oMERGE, oRESUME, oCACHE, oOUT_FILE, oLOCALE,
+#ifndef _NO_ZLIB
+		oGZIP,
+#endif
+		oTIME, oVERB };
+	string args;
+	bool skip = false;		// true if current option with its values is skipped
+
+	for (int i = 1; i < argc; i++) {
+		if (i == fileInd)	continue;
+		const int opt = Options::OptIndex(argv[i]);
+		if (opt >= 0)	skip = find(begin(skipped), end(skipped), opt) != end(skipped);
+		if (!skip)		args += string(argv[i]) + SPACE;
+	}
+	return args;
+}
+
 // Returns common name of output files
 string GetOutFileName()
 {
@@ -9,6 +9,10 @@ Provides option emum
 #pragma once
 #include "def.h"
 
+// Runs the simulation by the command line arguments, as the program does
+//	return: 0 if success, otherwise 1
+int Simulate(int argc, char* argv[]);
+
 #define	SAMPLE_FG()		grounds.Values().first
 #define	SAMPLE_BG()		grounds.Values().second
 
@@ -21,6 +25,8 @@ enum optValue {
 	oMDA,
 	oPCR_CYCLES,
 	oCHROM,
+	oREGION,
+	oREGIONS,
 	oBG_ALL,
 	//oBS_LEN,
 	oSMODE,
@@ -28,7 +34,18 @@ enum optValue {
 	oSTRAND_ERR,
 	oLET_GAPS,
 	oNUMB_THREAD,
+	oPIN,
+	oMEM_LIMIT,
+	oHUGE_PAGES,
+	oREPS,
+	oSHARD,
 	oSERV,
+	oPREPARE,
+	oJOBS,
+#ifdef __unix__
+	oSERVE,
+	oCONNECT,
+#endif
 	oSEED,
 	oOVERL,
 	oBS_SCORE,
@@ -44,7 +61,16 @@ enum optValue {
 	oMAP_QUAL,
 	oFORMAT,
 	oMAKE_INPUT,
+	oTIERS,
 	oSTRAND,
+	oDENS_BIN,
+	oDENS_STEP,
+	oWIG_MEM,
+	oBIGWIG,
+	oRENDER,
+	oMERGE,
+	oRESUME,
+	oCACHE,
 	oOUT_FILE,
 	oLOCALE,
 #ifndef _NO_ZLIB
@@ -0,0 +1,75 @@
+/**********************************************************
+libischip.cpp (c) 2014 Fedor Naumenko (fedor.naumenko@gmail.com)
+All rights reserved.
+-------------------------
+Last modified: 19.10.2026
+-------------------------
+Provides embeddable simulation API: isChIP run in the calling process,
+with Read records passed in memory
+***********************************************************/
+
+#include "libischip.h"
+#include "isChIP.h"
+
+mutex Simulation::Lock;
+
+// Runs the simulation
+//	@sink: records receiver
+//	@extra: additional options
+//	return: true if success, otherwise the error is printed to cerr
+bool Simulation::Run(ReadSink& sink, const vector<string>& extra) const
+{
+	// records only, silently; stated options override them
+	vector<string> args{ Product::Title, "-f", "REC", "-V", "SL",
+		"-g", _cfg.Genome,
+		"-n", to_string(_cfg.Cells),
+		"--seed", to_string(_cfg.Seed),
+		"-P", to_string(_cfg.Threads),
+		"--reps", to_string(_cfg.Reps) };
+	if (_cfg.Control)	args.push_back("-C");
+	args.insert(args.end(), _cfg.Options.begin(), _cfg.Options.end());
+	args.insert(args.end(), extra.begin(), extra.end());
+	if (_cfg.Template.length())	args.push_back(_cfg.Template);	// should be the last one
+
+	vector<char*> argv;
+	for (string& arg : args)	argv.push_back(&arg[0]);
+	argv.push_back(NULL);
+
+	lock_guard<mutex> lock(Lock);
+	Options::Reset();
+	Output::Sink = &sink;
+	const int ret = Simulate(int(args.size()), argv.data());
+	Output::Sink = NULL;
+	return !ret;
+}
+
+// Generates the Read records of one chrom
+//	@chrom: chrom's name, e.g. "chr1" or "1"
+//	@reads: records to fill
+//	@rep: replicate, 0-based
+//	@control: if true then control records are filled
+//	return: true if success, otherwise the error is printed to cerr
+bool Simulation::Reads(const string& chrom, ChromReads& reads, BYTE rep, bool control) const
+{
+	// collects the records of the stated replicate: the only chrom is generated
+	class Collector : public ReadSink
+	{
+		vector<RecOutFile::Rec>& _recs;
+		const BYTE	_rep;
+		const bool	_control;
+		mutex	_lock;
+	public:
+		Collector(vector<RecOutFile::Rec>& recs, BYTE rep, bool control)
+			: _recs(recs), _rep(rep), _control(control) {}
+
+		void Push(const Batch& batch) {
+			if (batch.Rep != _rep || batch.Control != _control)	return;
+			lock_guard<mutex> lock(_lock);
+			_recs.insert(_recs.end(), batch.Recs, batch.Recs + batch.Count);
+		}
+	} collector(reads._recs, rep, control);
+	const char* mark = Chrom::FindMark(chrom.c_str());		// skip 'chr' prefix
+
+	reads._recs.clear();
+	return Run(collector, { "-c", mark ? mark : chrom });
+}
@@ -0,0 +1,92 @@
+/**********************************************************
+libischip.h (c) 2014 Fedor Naumenko (fedor.naumenko@gmail.com)
+All rights reserved.
+-------------------------
+Last modified: 19.10.2026
+-------------------------
+Provides embeddable simulation API: isChIP run in the calling process,
+with Read records passed in memory
+***********************************************************/
+#pragma once
+#include "DataOutFile.h"	// ReadSink
+#include <mutex>
+
+// 'SimConfig' keeps the simulation settings
+struct SimConfig
+{
+	string	Genome;				// reference genome library [-g]
+	string	Template;			// template BED file, or empty in control mode
+	ULONG	Cells = 1;			// number of nominal cells [-n]
+	UINT	Seed = 0;			// random seed, or 0 if not fixed [--seed]
+	BYTE	Threads = 1;		// number of threads [-P]
+	BYTE	Reps = 1;			// number of replicates [--reps]
+	bool	Control = false;	// true if control is generated as well [-C]
+	vector<string> Options;		// other options as in the command line, e.g. { "--pcr", "2" }
+};
+
+// 'ChromReads' keeps the Read records of one chrom generated by Simulation::Reads()
+class ChromReads
+{
+	friend class Simulation;
+	typedef RecOutFile::Rec	Rec;
+
+	vector<Rec>	_recs;
+
+public:
+	typedef vector<Rec>::const_iterator const_iterator;
+
+	// Returns Read's start position
+	//	@rec: Read record
+	inline static chrlen ReadStart(const Rec& rec)
+	{ return rec.Reverse ? rec.Start + rec.Len - rec.RLen : rec.Start; }
+
+	// Returns number of records
+	inline size_t size() const { return _recs.size(); }
+
+	// Returns an iterator referring to the first record
+	inline const_iterator begin() const { return _recs.begin(); }
+
+	// Returns an iterator referring to the past-the-end record
+	inline const_iterator end() const { return _recs.end(); }
+};
+
+// 'Simulation' runs isChIP in the calling process, passing the Read records in memory.
+// The generator keeps its state in static members, so the runs are serialized by a global lock:
+// instances can be created and run any number of times from any threads,
+// but one run goes at a time, and a concurrent run waits until the current one is completed.
+// Each run starts from scratch: the options and the generator's state of the previous run are reset.
+// Chroms have their own random streams, so with a fixed seed the Reads of each chrom
+// do not depend on the other chroms and on the number of threads.
+class Simulation
+{
+	static mutex	Lock;	// serializes the runs
+
+	const SimConfig	_cfg;
+
+	// Runs the simulation
+	//	@sink: records receiver
+	//	@extra: additional options
+	//	return: true if success, otherwise the error is printed to cerr
+	bool Run(ReadSink& sink, const vector<string>& extra) const;
+
+public:
+	// Creates instance
+	//	@cfg: settings
+	inline Simulation(const SimConfig& cfg) : _cfg(cfg) {}
+
+	// Runs the simulation, pushing the Read records to the sink
+	//	@sink: records receiver
+	//	return: true if success, otherwise the error is printed to cerr
+	inline bool Run(ReadSink& sink) const { return Run(sink, vector<string>()); }
+
+	// Generates the Read records of one chrom.
+	// The records are the same as pushed by Run(), unless the Reads limit is achieved.
+	// The whole chrom is generated into the vector before returning, not pulled on demand,
+	// so it takes the memory of all chrom's records.
+	//	@chrom: chrom's name, e.g. "chr1" or "1"
+	//	@reads: records to fill
+	//	@rep: replicate, 0-based
+	//	@control: if true then control records are filled
+	//	return: true if success, otherwise the error is printed to cerr
+	bool Reads(const string& chrom, ChromReads& reads, BYTE rep = 0, bool control = false) const;
+};